@@ -5,6 +5,7 @@
 #-------------------------------------------------
 
 QT       -= gui
+QT       += concurrent
 
 TARGET = qkeeg
 TEMPLATE = lib
@@ -32,9 +33,22 @@ OBJECTS_DIR = $${INTERMEDIATE}/.obj
 INCLUDEPATH += src
 
 SOURCES += \
+    src/common/workstealingpool.cpp \
     src/io/binaryreader.cpp \
     src/io/binarywriter.cpp \
+    src/io/bufferpool.cpp \
+    src/io/positionalreader.cpp \
+    src/io/readaheadreader.cpp \
     src/hashing/hashalgorithm.cpp \
+    src/hashing/hashalgorithmregistry.cpp \
+    src/hashing/multihasher.cpp \
+    src/hashing/blocklisthasher.cpp \
+    src/hashing/hashasync.cpp \
+    src/hashing/treehasher.cpp \
+    src/hashing/digestcache.cpp \
+    src/hashing/hashwatcher.cpp \
+    src/hashing/duplicatefinder.cpp \
+    src/hashing/directfilehasher.cpp \
     src/hashing/crc/crc32.cpp \
     src/hashing/crc/crc64.cpp \
     src/hashing/checksum/adler32.cpp \
@@ -67,12 +81,30 @@ HEADERS += \
     src/common/enums.hpp \
     src/common/endian.hpp \
     src/common/intrinsic.hpp \
+    src/common/workstealingpool.hpp \
     src/io/binaryreader.hpp \
     src/io/binarywriter.hpp \
+    src/io/bufferpool.hpp \
+    src/io/positionalreader.hpp \
+    src/io/readaheadreader.hpp \
     src/hashing/hashalgorithm.hpp \
+    src/hashing/digest.hpp \
+    src/hashing/hashalgorithmregistry.hpp \
+    src/hashing/multihasher.hpp \
+    src/hashing/blocklisthasher.hpp \
+    src/hashing/hashasync.hpp \
+    src/hashing/treehasher.hpp \
+    src/hashing/digestcache.hpp \
+    src/hashing/hashwatcher.hpp \
+    src/hashing/duplicatefinder.hpp \
+    src/hashing/stdhash.hpp \
+    src/hashing/constexprhash.hpp \
+    src/hashing/hasher.hpp \
+    src/hashing/directfilehasher.hpp \
     src/common/cryptotransform.hpp \
     src/hashing/crc/crc32.hpp \
     src/hashing/crc/crc64.hpp \
+    src/hashing/crc/zerorunoperator.hpp \
     src/hashing/checksum/adler32.hpp \
     src/hashing/checksum/fletcher32.hpp \
     src/hashing/noncryptographic/aphash32.hpp \
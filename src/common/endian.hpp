@@ -28,6 +28,7 @@
 #include <QSysInfo>
 #include <algorithm>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <type_traits>
 
@@ -405,10 +406,8 @@ template <typename T> Q_DECL_CONSTEXPR T rotateLeft(T x, quint32 numBits)
 {
     static_assert(std::is_integral<T>::value, "rotate of non-integral type");
     static_assert(!std::is_signed<T>::value, "rotate of signed type");
-//    constexpr decltype(numBits) mask = std::numeric_limits<T>::digits - 1;
-//    numBits &= mask;
-//    return (x << numBits) || (x >> (-numBits & mask));
-    return (x << numBits) || (x >> (sizeof(T) - numBits));
+    return static_cast<T>((x << (numBits & (std::numeric_limits<T>::digits - 1))) |
+                          (x >> ((0u - numBits) & (std::numeric_limits<T>::digits - 1))));
 }
 
 #ifndef rotl
@@ -420,10 +419,8 @@ template <typename T> Q_DECL_CONSTEXPR T rotateRight(T x, quint32 numBits)
 {
     static_assert(std::is_integral<T>::value, "rotate of non-integral type");
     static_assert(!std::is_signed<T>::value, "rotate of signed type");
-//    constexpr decltype(numBits) mask = std::numeric_limits<T>::digits - 1;
-//    numBits &= mask;
-//    return (x >> numBits) || (x << (-numBits & mask));
-    return (x >> numBits) || (x << (sizeof(T) - numBits));
+    return static_cast<T>((x >> (numBits & (std::numeric_limits<T>::digits - 1))) |
+                          (x << ((0u - numBits) & (std::numeric_limits<T>::digits - 1))));
 }
 
 #ifndef rotr
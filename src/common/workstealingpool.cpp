@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "workstealingpool.hpp"
+#include <QThread>
+
+namespace qkeeg {
+namespace common {
+
+namespace {
+
+/// Pool and worker the current thread belongs to, if any.
+thread_local const WorkStealingPool *currentPool = nullptr;
+thread_local int currentWorker = -1;
+
+} // anonymous namespace
+
+WorkStealingPool::WorkStealingPool(int threadCount) :
+    m_queued(0), m_nextWorker(0)
+{
+    if (threadCount < 1) {
+        threadCount = qMax(1, QThread::idealThreadCount());
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        m_workers[static_cast<std::size_t>(i)]->thread = QThread::create([this, i]() { workerLoop(i); });
+        m_workers[static_cast<std::size_t>(i)]->thread->start();
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    waitForDone();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_workAvailable.wakeAll();
+    }
+
+    for (auto &worker : m_workers) {
+        worker->thread->wait();
+        delete worker->thread;
+    }
+}
+
+int WorkStealingPool::threadCount() const
+{
+    return static_cast<int>(m_workers.size());
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    // Counted before it is visible, so waitForDone() can't see zero while it is queued.
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_pending;
+    }
+
+    const std::size_t index = (currentPool == this)
+            ? static_cast<std::size_t>(currentWorker)
+            : (m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size());
+    {
+        Worker &worker = *m_workers[index];
+        QMutexLocker locker(&worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    ++m_queued;
+    m_workAvailable.wakeOne();
+}
+
+void WorkStealingPool::waitForDone()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_pending > 0) {
+        m_allDone.wait(&m_mutex);
+    }
+}
+
+void WorkStealingPool::workerLoop(int index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    Task task;
+    for (;;) {
+        if (takeTask(index, task)) {
+            task();
+            task = nullptr;
+
+            QMutexLocker locker(&m_mutex);
+            if (--m_pending == 0) {
+                m_allDone.wakeAll();
+            }
+            continue;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        while ((m_queued.load() <= 0) && !m_stop) {
+            m_workAvailable.wait(&m_mutex);
+        }
+        if (m_stop) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::takeTask(int index, Task &task)
+{
+    const std::size_t count = m_workers.size();
+
+    // Own queue from the back, newest first.
+    {
+        Worker &own = *m_workers[static_cast<std::size_t>(index)];
+        QMutexLocker locker(&own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --m_queued;
+            return true;
+        }
+    }
+
+    // Steal from the front of the others, oldest first.
+    for (std::size_t offset = 1; offset < count; ++offset) {
+        Worker &victim = *m_workers[(static_cast<std::size_t>(index) + offset) % count];
+        QMutexLocker locker(&victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --m_queued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace common
+} // namespace qkeeg
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+namespace qkeeg {
+namespace common {
+
+//! Fixed set of worker threads with a task queue each. A worker runs its newest task first, so
+//! tasks spawned by a task stay on the thread whose caches hold their data; a worker that runs
+//! dry steals the oldest task of another, which tends to be the largest piece of work left.
+//! Tasks submitted from outside are spread round robin.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    //! threadCount < 1 uses QThread::idealThreadCount().
+    explicit WorkStealingPool(int threadCount = 0);
+    //! Waits for all tasks, then stops the workers.
+    ~WorkStealingPool();
+
+    int threadCount() const;
+
+    //! Queue a task. From a task of this pool it goes to the current worker's queue. Tasks must
+    //! not throw.
+    void submit(Task task);
+    //! Block until every task, including the ones queued by tasks, has run.
+    void waitForDone();
+
+private:
+    Q_DISABLE_COPY(WorkStealingPool)
+
+    struct Worker
+    {
+        QMutex mutex;
+        std::deque<Task> tasks;
+        QThread *thread = nullptr;
+    };
+
+    void workerLoop(int index);
+    bool takeTask(int index, Task &task);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    QMutex m_mutex;
+    QWaitCondition m_workAvailable;
+    QWaitCondition m_allDone;
+    //! Tasks submitted but not finished, guarded by m_mutex.
+    int m_pending = 0;
+    //! Tasks sitting in a queue; briefly negative while a submit races a take.
+    std::atomic<int> m_queued;
+    bool m_stop = false;
+    std::atomic<unsigned> m_nextWorker;
+};
+
+} // namespace common
+} // namespace qkeeg
+
+#endif // WORKSTEALINGPOOL_HPP
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "blocklisthasher.hpp"
+#include "hashalgorithmregistry.hpp"
+#include "../io/bufferpool.hpp"
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cstring>
+
+namespace qkeeg { namespace hashing {
+
+BlockListHasher::BlockListHasher(std::unique_ptr<HashAlgorithm> blockAlgorithm, qint64 blockSize,
+                                 std::unique_ptr<HashAlgorithm> overallAlgorithm) :
+    m_blockAlgorithm(std::move(blockAlgorithm)), m_overallAlgorithm(std::move(overallAlgorithm)),
+    m_blockSize(blockSize)
+{
+    if (!m_blockAlgorithm) {
+        throw QString("Algorithm is null.");
+    }
+    if (m_blockSize <= 0) {
+        throw QString("Invalid block size.");
+    }
+    m_blockAlgorithm->requireIncremental();
+    if (m_overallAlgorithm) {
+        m_overallAlgorithm->requireIncremental();
+    }
+
+    reset();
+}
+
+BlockListHasher::BlockListHasher(const QString &blockAlgorithm, qint64 blockSize, const QString &overallAlgorithm) :
+    m_blockSize(blockSize)
+{
+    m_blockAlgorithm = HashAlgorithmRegistry::instance().create(blockAlgorithm);
+    if (!m_blockAlgorithm) {
+        throw QString("Unknown hash algorithm: %1").arg(blockAlgorithm);
+    }
+    if (!overallAlgorithm.isEmpty()) {
+        m_overallAlgorithm = HashAlgorithmRegistry::instance().create(overallAlgorithm);
+        if (!m_overallAlgorithm) {
+            throw QString("Unknown hash algorithm: %1").arg(overallAlgorithm);
+        }
+    }
+    if (m_blockSize <= 0) {
+        throw QString("Invalid block size.");
+    }
+    m_blockAlgorithm->requireIncremental();
+    if (m_overallAlgorithm) {
+        m_overallAlgorithm->requireIncremental();
+    }
+
+    reset();
+}
+
+BlockListHasher::~BlockListHasher()
+{
+    collectBlocks(0);
+}
+
+qint64 BlockListHasher::blockSize() const
+{
+    return m_blockSize;
+}
+
+HashAlgorithm &BlockListHasher::blockAlgorithm()
+{
+    return *m_blockAlgorithm;
+}
+
+HashAlgorithm *BlockListHasher::overallAlgorithm()
+{
+    return m_overallAlgorithm.get();
+}
+
+bool BlockListHasher::isParallel() const
+{
+    return m_parallel;
+}
+
+void BlockListHasher::setParallel(bool parallel)
+{
+    m_parallel = parallel;
+}
+
+QVector<QByteArray> BlockListHasher::computeHash(const QByteArray &data)
+{
+    return computeHash(data.constData(), data.size());
+}
+
+QVector<QByteArray> BlockListHasher::computeHash(const void *data, qint64 length)
+{
+    reset();
+    update(data, length);
+    return finalize();
+}
+
+bool BlockListHasher::computeHash(QIODevice &instream)
+{
+    if (!instream.isReadable()) {
+        return false;
+    }
+
+    instream.seek(0);
+    reset();
+
+    qint64 bytesToRead = instream.size();
+    io::BufferPool::Buffer buffer;
+    if (!m_useThreads) {
+        buffer = HashAlgorithm::bufferPool().acquire();
+    }
+    const qint64 readSize = HashAlgorithm::bufferPool().bufferSize();
+
+    while (bytesToRead > 0) {
+        qint64 numBytesRead;
+        if (m_useThreads) {
+            // Read straight into the block that is handed to the pool, saving a copy.
+            if (m_block.isEmpty()) {
+                m_block.resize(static_cast<int>(m_blockSize));
+            }
+
+            char *current = m_block.data() + m_blockFill;
+            numBytesRead = instream.read(current, qMin(qMin(bytesToRead, m_blockSize - m_blockFill), readSize));
+            if (numBytesRead > 0) {
+                if (m_overallAlgorithm) {
+                    m_overallAlgorithm->update(current, numBytesRead);
+                }
+
+                m_blockFill += numBytesRead;
+                if (m_blockFill == m_blockSize) {
+                    finishBlock();
+                }
+            }
+        }
+        else {
+            numBytesRead = instream.read(buffer.data(), qMin(bytesToRead, buffer.size()));
+            if (numBytesRead > 0) {
+                update(buffer.data(), numBytesRead);
+            }
+        }
+
+        // There was an error reading the IO device.
+        if (numBytesRead <= 0) {
+            reset();
+            return false;
+        }
+
+        bytesToRead -= numBytesRead;
+    }
+
+    finalize();
+    return true;
+}
+
+void BlockListHasher::update(const void *data, qint64 length)
+{
+    if (length < 0) {
+        throw QString("Invalid length.");
+    }
+    if (length == 0) {
+        return;
+    }
+    if (data == nullptr) {
+        throw QString("Data pointer is null.");
+    }
+
+    if (m_overallAlgorithm) {
+        m_overallAlgorithm->update(data, length);
+    }
+
+    const char *current = static_cast<const char*>(data);
+    while (length > 0) {
+        const qint64 part = qMin(length, m_blockSize - m_blockFill);
+        if (m_useThreads) {
+            if (m_block.isEmpty()) {
+                m_block.resize(static_cast<int>(m_blockSize));
+            }
+
+            std::memcpy(m_block.data() + m_blockFill, current, static_cast<std::size_t>(part));
+        }
+        else {
+            m_blockAlgorithm->update(current, part);
+        }
+
+        m_blockFill += part;
+        current += part;
+        length -= part;
+
+        if (m_blockFill == m_blockSize) {
+            finishBlock();
+        }
+    }
+}
+
+void BlockListHasher::update(const QByteArray &data)
+{
+    update(data.constData(), data.size());
+}
+
+QVector<QByteArray> BlockListHasher::finalize()
+{
+    if (m_blockFill > 0) {
+        finishBlock();
+    }
+
+    collectBlocks(0);
+    m_hashValue = m_overallAlgorithm ? m_overallAlgorithm->finalize() : QByteArray();
+    return m_blockHashes;
+}
+
+void BlockListHasher::reset()
+{
+    collectBlocks(0);
+
+    m_blockAlgorithm->reset();
+    if (m_overallAlgorithm) {
+        m_overallAlgorithm->reset();
+    }
+
+    m_useThreads = m_parallel && (m_blockSize >= MinParallelBlock) && (m_blockSize <= MaxPendingBytes);
+    m_maxPending = qBound(1, static_cast<int>(MaxPendingBytes / m_blockSize),
+                          qMax(1, QThreadPool::globalInstance()->maxThreadCount()));
+
+    m_blockFill = 0;
+    m_block = QByteArray();
+    m_blockHashes.clear();
+    m_hashValue.clear();
+}
+
+QVector<QByteArray> BlockListHasher::blockHashes() const
+{
+    return m_blockHashes;
+}
+
+QByteArray BlockListHasher::concatenatedBlockHashes() const
+{
+    QByteArray result;
+    for (const QByteArray &digest : m_blockHashes) {
+        result.append(digest);
+    }
+
+    return result;
+}
+
+QByteArray BlockListHasher::hashValue() const
+{
+    return m_hashValue;
+}
+
+QString BlockListHasher::multipartETag() const
+{
+    std::unique_ptr<HashAlgorithm> algorithm = m_blockAlgorithm->clone();
+    if (m_blockHashes.isEmpty()) {
+        return QString(algorithm->computeHash(nullptr, 0).toHex());
+    }
+    if (m_blockHashes.size() == 1) {
+        return QString(m_blockHashes.first().toHex());
+    }
+
+    const QByteArray digest = algorithm->computeHash(concatenatedBlockHashes());
+    return QString(digest.toHex()) + QLatin1Char('-') + QString::number(m_blockHashes.size());
+}
+
+void BlockListHasher::finishBlock()
+{
+    const int index = m_blockHashes.size();
+    m_blockHashes.append(QByteArray());
+
+    if (m_useThreads) {
+        collectBlocks(m_maxPending - 1);
+
+        // The task shares the block, the next one gets a fresh buffer.
+        const QByteArray block = m_block;
+        const qint64 length = m_blockFill;
+        std::shared_ptr<HashAlgorithm> algorithm(m_blockAlgorithm->clone());
+        m_pending.append(qMakePair(index, QtConcurrent::run(QThreadPool::globalInstance(), [algorithm, block, length]() {
+            return algorithm->computeHash(block.constData(), length);
+        })));
+        m_block = QByteArray();
+    }
+    else {
+        m_blockHashes[index] = m_blockAlgorithm->finalize();
+    }
+
+    m_blockFill = 0;
+}
+
+void BlockListHasher::collectBlocks(int maxPending)
+{
+    while (m_pending.size() > qMax(maxPending, 0)) {
+        QPair<int, QFuture<QByteArray>> job = m_pending.takeFirst();
+        m_blockHashes[job.first] = job.second.result();
+    }
+}
+
+} // namespace hashing
+} // namespace qkeeg
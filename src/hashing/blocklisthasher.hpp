@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef BLOCKLISTHASHER_HPP
+#define BLOCKLISTHASHER_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QFuture>
+#include <QIODevice>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+namespace qkeeg { namespace hashing {
+
+//! Splits a message into fixed size blocks and hashes each block on its own, optionally together
+//! with a digest of the whole message, all from a single pass. Covers S3 multipart ETags (md5 per
+//! part), BitTorrent v1 pieces (sha1 per piece) and per-chunk integrity lists.
+class BlockListHasher
+{
+    Q_GADGET
+
+public:
+    //! blockAlgorithm hashes every blockSize bytes, the last block may be shorter. overallAlgorithm,
+    //! if given, hashes the whole message. Throws a QString for a null block algorithm, a bad size
+    //! or algorithms that aren't isIncremental().
+    BlockListHasher(std::unique_ptr<HashAlgorithm> blockAlgorithm, qint64 blockSize,
+                    std::unique_ptr<HashAlgorithm> overallAlgorithm = nullptr);
+    //! Creates the algorithms from the registry. Throws a QString for unknown names
+    //! and for algorithms that aren't isIncremental().
+    BlockListHasher(const QString &blockAlgorithm, qint64 blockSize, const QString &overallAlgorithm = QString());
+    ~BlockListHasher();
+
+    qint64 blockSize() const;
+    HashAlgorithm &blockAlgorithm();
+    //! nullptr if only blocks are hashed.
+    HashAlgorithm *overallAlgorithm();
+
+    //! Hash the blocks on the global thread pool, while the whole message is hashed on the calling
+    //! thread. Takes effect with the next message.
+    bool isParallel() const;
+    void setParallel(bool parallel);
+
+    //! Compute the block digests, and the overall digest if there is an overall algorithm.
+    QVector<QByteArray> computeHash(const QByteArray &data);
+    QVector<QByteArray> computeHash(const void *data, qint64 length);
+    //! Reads the device once. Returns false on a read error, the digests are cleared then.
+    bool computeHash(QIODevice &instream);
+
+    void update(const void *data, qint64 length);
+    void update(const QByteArray &data);
+    //! Hash the last, partial, block and return the block digests. An empty message has none.
+    QVector<QByteArray> finalize();
+    void reset();
+
+    //! Block digests from the last finalize(), in message order.
+    QVector<QByteArray> blockHashes() const;
+    //! Block digests back to back, e.g. the "pieces" field of a BitTorrent v1 info dictionary.
+    QByteArray concatenatedBlockHashes() const;
+    //! Overall digest from the last finalize(), empty without an overall algorithm.
+    QByteArray hashValue() const;
+    //! ETag as S3 computes it for a multipart upload with md5 blocks: the lower case hex digest
+    //! of the concatenated block digests, a dash and the block count. A single block gives its
+    //! plain hex digest.
+    QString multipartETag() const;
+
+private:
+    Q_DISABLE_COPY(BlockListHasher)
+
+    void finishBlock();
+    //! Wait for hashed blocks until at most maxPending are left.
+    void collectBlocks(int maxPending);
+
+    /// Blocks smaller than this are not worth a thread hand-off.
+    static const qint64 MinParallelBlock = Q_INT64_C(65536);
+    /// Upper bound for the memory held by blocks waiting to be hashed.
+    static const qint64 MaxPendingBytes = Q_INT64_C(268435456);
+
+    std::unique_ptr<HashAlgorithm> m_blockAlgorithm;
+    std::unique_ptr<HashAlgorithm> m_overallAlgorithm;
+    qint64 m_blockSize;
+    bool m_parallel = true;
+
+    //! Parallel mode of the current message, fixed by reset().
+    bool m_useThreads = false;
+    int m_maxPending = 1;
+    //! Bytes of the current block so far; in parallel mode they are collected in m_block.
+    qint64 m_blockFill = 0;
+    QByteArray m_block;
+    QVector<QPair<int, QFuture<QByteArray>>> m_pending;
+
+    QVector<QByteArray> m_blockHashes;
+    QByteArray m_hashValue;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // BLOCKLISTHASHER_HPP
@@ -21,6 +21,8 @@
  */
 #include "adler32.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace checksum {
 
@@ -35,6 +37,16 @@ Adler32::Adler32()
     initialize();
 }
 
+quint32 Adler32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    Adler32 algorithm;
+    algorithm.hashCore(data, 0, static_cast<qint64>(length));
+
+    quint32 result;
+    algorithm.hashFinalInto(&result);
+    return result;
+}
+
 void Adler32::initialize()
 {
     m_hash = m_seed;
@@ -46,7 +58,53 @@ quint32 Adler32::hashSize()
     return m_hashSize;
 }
 
-void Adler32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Adler32::clone() const
+{
+    return std::make_unique<Adler32>(*this);
+}
+
+QString Adler32::name() const
+{
+    return QStringLiteral("adler32");
+}
+
+bool Adler32::isCombinable() const
+{
+    return true;
+}
+
+void Adler32::combineCore(const HashAlgorithm &next, quint64 nextLength)
+{
+    const Adler32 *other = dynamic_cast<const Adler32*>(&next);
+    if (other == nullptr) {
+        throw QString("Algorithms can't be combined.");
+    }
+
+    // Same as zlib's adler32_combine(): next's a is added to ours, and our a weighs into b once
+    // for every byte of next.
+    const quint32 remainder = static_cast<quint32>(nextLength % m_modAdler);
+    quint32 a = m_hash & UINT32_C(0xFFFF);
+    quint32 b = (remainder * a) % m_modAdler;
+    a += (other->m_hash & UINT32_C(0xFFFF)) + m_modAdler - 1;
+    b += ((m_hash >> 16) & UINT32_C(0xFFFF)) + ((other->m_hash >> 16) & UINT32_C(0xFFFF)) + m_modAdler - remainder;
+
+    if (a >= m_modAdler) {
+        a -= m_modAdler;
+    }
+    if (a >= m_modAdler) {
+        a -= m_modAdler;
+    }
+    if (b >= (m_modAdler << 1)) {
+        b -= (m_modAdler << 1);
+    }
+    if (b >= m_modAdler) {
+        b -= m_modAdler;
+    }
+
+    m_hash = a | (b << 16);
+}
+
+void Adler32::hashCore(const void *data, qint64 offset, qint64 count)
 {
     quint32 a = m_hash & UINT32_C(0xFFFF);
     quint32 b = (m_hash >> 16) & UINT32_C(0xFFFF);
@@ -97,11 +155,20 @@ void Adler32::hashCore(const void *data, const qint64 &offset, const qint64 &cou
     }
 }
 
-QByteArray Adler32::hashFinal()
+void Adler32::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint32>(m_hash, hash);
+}
+
+void Adler32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
+}
+
+bool Adler32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace checksum
@@ -21,6 +21,8 @@
  */
 #include "fletcher32.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace checksum {
 
@@ -29,10 +31,23 @@ Fletcher32::Fletcher32() : m_sum1(m_seed), m_sum2(m_seed)
     initialize();
 }
 
+quint32 Fletcher32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    Fletcher32 algorithm;
+    algorithm.hashCore(data, 0, static_cast<qint64>(length));
+
+    quint32 result;
+    algorithm.hashFinalInto(&result);
+    return result;
+}
+
 void Fletcher32::initialize()
 {
     m_sum1 = m_seed;
     m_sum2 = m_seed;
+    m_words = 0;
+    m_pendingByte = 0;
+    m_hasPendingByte = false;
     m_hashValue.clear();
 }
 
@@ -41,38 +56,99 @@ quint32 Fletcher32::hashSize()
     return m_hashSize;
 }
 
-void Fletcher32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Fletcher32::clone() const
 {
-    const quint8  *temp = reinterpret_cast<const quint8*>(data) + offset;
-    const quint16 *current = reinterpret_cast<const quint16*>(temp);
+    return std::make_unique<Fletcher32>(*this);
+}
+
+QString Fletcher32::name() const
+{
+    return QStringLiteral("fletcher32");
+}
+
+void Fletcher32::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+    if (count <= 0) {
+        return;
+    }
+
+    if (m_hasPendingByte) {
+        const quint8 word[2] = { m_pendingByte, *current++ };
+        addWord(common::from_unaligned<quint16>(word));
+        m_hasPendingByte = false;
+        --count;
+    }
 
     quint64 words = count / 2;
-    quint16 tlen;
     while (words) {
-        tlen = (words >= 359) ? 359 : words;
+        const quint32 tlen = static_cast<quint32>(qMin<quint64>(words, m_foldWords - m_words));
         words -= tlen;
-        do {
-            m_sum1 += common::from_unaligned<quint16>(current++);
+        for (quint32 i = 0; i < tlen; ++i) {
+            m_sum1 += common::from_unaligned<quint16>(current);
             m_sum2 += m_sum1;
-            tlen--;
+            current += sizeof(quint16);
+        }
+
+        m_words += tlen;
+        if (m_words == m_foldWords) {
+            m_sum1 = (m_sum1 & UINT32_C(0xFFFF)) + (m_sum1 >> 16);
+            m_sum2 = (m_sum2 & UINT32_C(0xFFFF)) + (m_sum2 >> 16);
+            m_words = 0;
         }
-        while (tlen);
+    }
+
+    if ((count & 1) != 0) {
+        m_pendingByte = *current;
+        m_hasPendingByte = true;
+    }
+}
 
+void Fletcher32::addWord(quint16 word)
+{
+    m_sum1 += word;
+    m_sum2 += m_sum1;
+    if (++m_words == m_foldWords) {
         m_sum1 = (m_sum1 & UINT32_C(0xFFFF)) + (m_sum1 >> 16);
         m_sum2 = (m_sum2 & UINT32_C(0xFFFF)) + (m_sum2 >> 16);
+        m_words = 0;
     }
 }
 
-QByteArray Fletcher32::hashFinal()
+void Fletcher32::hashFinalInto(void *hash)
 {
+    // Close the last, partial run of words like a full one, then fold once more.
+    if (m_words != 0) {
+        m_sum1 = (m_sum1 & UINT32_C(0xFFFF)) + (m_sum1 >> 16);
+        m_sum2 = (m_sum2 & UINT32_C(0xFFFF)) + (m_sum2 >> 16);
+        m_words = 0;
+    }
+
     m_sum1 = (m_sum1 & UINT32_C(0xFFFF)) + (m_sum1 >> 16);
     m_sum2 = (m_sum2 & UINT32_C(0xFFFF)) + (m_sum2 >> 16);
 
-    quint32 hash = (m_sum2 << 16) | m_sum1;
+    quint32 result = (m_sum2 << 16) | m_sum1;
+
+    common::to_unaligned<quint32>(result, hash);
+}
 
-    QByteArray buffer(sizeof(hash), char(0));
-    common::to_unaligned<quint32>(hash, buffer.data());
-    return buffer;
+void Fletcher32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_sum1);
+    writer.write(m_sum2);
+    writer.write(m_words);
+    writer.write(m_pendingByte);
+    writer.write(m_hasPendingByte);
+}
+
+bool Fletcher32::readState(io::BinaryReader &reader)
+{
+    m_sum1 = reader.readUInt32();
+    m_sum2 = reader.readUInt32();
+    m_words = reader.readUInt32();
+    m_pendingByte = reader.readByte();
+    m_hasPendingByte = reader.readBoolean();
+    return m_words < m_foldWords;
 }
 
 } // namespace checksum
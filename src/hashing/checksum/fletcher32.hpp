@@ -33,20 +33,39 @@ class Fletcher32 : public HashAlgorithm
 public:
     Fletcher32();
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    static quint32 hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT;
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_seed = UINT32_C(0xFFFF);
     static const quint32 m_hashSize = std::numeric_limits<uint32_t>::digits;
+    //! Words summed between two folds, 359 keeps the sums from overflowing.
+    static const quint32 m_foldWords = 359;
+
+    void addWord(quint16 word);
+
     quint32 m_sum1 = m_seed;
     quint32 m_sum2 = m_seed;
+    //! Words summed since the last fold, carried over so the folds fall on the same words however
+    //! the message is split.
+    quint32 m_words = 0;
+    //! First byte of a word whose second byte is in the next update(). A byte still pending at
+    //! the end of the message is not hashed.
+    quint8  m_pendingByte = 0;
+    bool    m_hasPendingByte = false;
 
     static_assert(std::is_same<quint8, unsigned char>::value,
                   "quint8 is required to be implemented as unsigned char!");
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef CONSTEXPRHASH_HPP
+#define CONSTEXPRHASH_HPP
+
+#include "crc/crc32.hpp"
+#include <QtGlobal>
+#include <cstddef>
+
+// Compile time versions of the simple hashes. Each gives the same value as the static hash() of
+// the matching class, so "name"_fnv1a can be used in case labels and constant tables.
+
+namespace qkeeg { namespace hashing { namespace compiletime {
+
+namespace detail {
+
+Q_DECL_CONSTEXPR inline quint32 byteAt(const char *data, std::size_t index)
+{
+    return static_cast<quint32>(static_cast<quint8>(data[index]));
+}
+
+struct Crc32Table
+{
+    quint32 entries[256];
+};
+
+Q_DECL_RELAXED_CONSTEXPR inline Crc32Table makeCrc32Table(quint32 polynomial)
+{
+    Crc32Table table = {};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 entry = i;
+        for (int j = 0; j < 8; ++j) {
+            entry = (entry >> 1) ^ ((entry & 1) * polynomial);
+        }
+
+        table.entries[i] = entry;
+    }
+
+    return table;
+}
+
+template<quint32 Polynomial>
+struct Crc32TableHolder
+{
+    static constexpr Crc32Table table = makeCrc32Table(Polynomial);
+};
+
+template<quint32 Polynomial>
+constexpr Crc32Table Crc32TableHolder<Polynomial>::table;
+
+} // namespace detail
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 fnv1Hash32(const char *data, std::size_t length)
+{
+    quint32 hash = UINT32_C(2166136261);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (UINT32_C(16777619) * hash) ^ detail::byteAt(data, i);
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint64 fnv1Hash64(const char *data, std::size_t length)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (Q_UINT64_C(1099511628211) * hash) ^ detail::byteAt(data, i);
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 fnv1aHash32(const char *data, std::size_t length)
+{
+    quint32 hash = UINT32_C(2166136261);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (detail::byteAt(data, i) ^ hash) * UINT32_C(16777619);
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint64 fnv1aHash64(const char *data, std::size_t length)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (detail::byteAt(data, i) ^ hash) * Q_UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 djb2Hash32(const char *data, std::size_t length)
+{
+    quint32 hash = UINT32_C(5381);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = ((hash << 5) + hash) + detail::byteAt(data, i); /* hash * 33 + c */
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 sdbmHash32(const char *data, std::size_t length)
+{
+    quint32 hash = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = detail::byteAt(data, i) + (hash << 6) + (hash << 16) - hash;
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 bkdrHash32(const char *data, std::size_t length, quint32 seed = UINT32_C(131))
+{
+    quint32 hash = seed;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (hash * seed) + detail::byteAt(data, i);
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 jsHash32(const char *data, std::size_t length)
+{
+    quint32 hash = UINT32_C(1315423911);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= ((hash << 5) + detail::byteAt(data, i) + (hash >> 2));
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 elfHash32(const char *data, std::size_t length)
+{
+    quint32 hash = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (hash << 4) + detail::byteAt(data, i);
+        const quint32 x = hash & UINT32_C(0xF0000000);
+        if (x != 0) {
+            hash ^= (x >> 24);
+        }
+
+        hash &= ~x;
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 pjwHash32(const char *data, std::size_t length)
+{
+    // PJW with 32 bit words: shift by one eighth, fold the high eighth back in at three quarters.
+    quint32 hash = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash = (hash << 4) + detail::byteAt(data, i);
+        const quint32 test = hash & UINT32_C(0xF0000000);
+        if (test != 0) {
+            hash = ((hash ^ (test >> 24)) & ~UINT32_C(0xF0000000));
+        }
+    }
+
+    return hash;
+}
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 apHash32(const char *data, std::size_t length)
+{
+    quint32 hash = UINT32_C(0xAAAAAAAA);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= ((i & 0x01) == 0) ? (  (hash <<  7) ^ detail::byteAt(data, i) ^ (hash >> 3)) :
+                                    (~((hash << 11) ^ detail::byteAt(data, i) ^ (hash >> 5)));
+    }
+
+    return hash;
+}
+
+//! Byte at a time CRC32, same result as the sliced crc::Crc32 for the same polynomial and seed.
+template<quint32 Polynomial = DEFAULT_POLYNOMIAL32>
+Q_DECL_RELAXED_CONSTEXPR inline quint32 crc32(const char *data, std::size_t length, quint32 seed = 0)
+{
+    quint32 crc = ~seed;
+    for (std::size_t i = 0; i < length; ++i) {
+        crc = (crc >> 8) ^ detail::Crc32TableHolder<Polynomial>::table.entries[(crc ^ detail::byteAt(data, i)) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+} // namespace compiletime
+
+//! String literal suffixes, e.g. switch (id) { case "login"_fnv1a: ... }
+namespace literals {
+
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _fnv1(const char *str, std::size_t length)       { return compiletime::fnv1Hash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint64 operator"" _fnv1_64(const char *str, std::size_t length)    { return compiletime::fnv1Hash64(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _fnv1a(const char *str, std::size_t length)      { return compiletime::fnv1aHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint64 operator"" _fnv1a_64(const char *str, std::size_t length)   { return compiletime::fnv1aHash64(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _djb2(const char *str, std::size_t length)       { return compiletime::djb2Hash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _sdbm(const char *str, std::size_t length)       { return compiletime::sdbmHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _bkdr(const char *str, std::size_t length)       { return compiletime::bkdrHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _js(const char *str, std::size_t length)         { return compiletime::jsHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _elf(const char *str, std::size_t length)        { return compiletime::elfHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _pjw(const char *str, std::size_t length)        { return compiletime::pjwHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _ap(const char *str, std::size_t length)         { return compiletime::apHash32(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _crc32(const char *str, std::size_t length)      { return compiletime::crc32<DEFAULT_POLYNOMIAL32>(str, length); }
+Q_DECL_RELAXED_CONSTEXPR inline quint32 operator"" _crc32c(const char *str, std::size_t length)     { return compiletime::crc32<CASTAGNOLI_POLYNOMIAL>(str, length); }
+
+} // namespace literals
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // CONSTEXPRHASH_HPP
@@ -21,6 +21,14 @@
  */
 #include "crc32.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
+
+#if defined(Q_PROCESSOR_X86_64) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+    // CRC32C instruction of SSE 4.2, selected at runtime.
+    #define CRC32_HARDWARE_CRC32C
+    #include <nmmintrin.h>
+#endif
 
 namespace qkeeg { namespace hashing { namespace crc {
 
@@ -28,7 +36,20 @@ Crc32::Crc32(const quint32 &polynomial, const quint32 &seed) : HashAlgorithm(),
     m_polynomial(polynomial), m_seed(seed)
 {
     initialize();
-    initializeTable();
+
+    // Only a custom polynomial needs its own table, copies of this instance share it.
+    m_lookupTable = sharedTable(m_polynomial);
+    if (m_lookupTable == nullptr) {
+        m_ownedTable = std::make_shared<const LookupTable>(makeTable(m_polynomial));
+        m_lookupTable = m_ownedTable.get();
+    }
+
+    m_useHardware = (m_polynomial == CASTAGNOLI_POLYNOMIAL) && hasHardwareCrc32c();
+}
+
+quint32 Crc32::hash(const void *data, std::size_t length, quint32 seed) Q_DECL_NOEXCEPT
+{
+    return compute(defaultTable(), seed, data, length);
 }
 
 void Crc32::initialize()
@@ -42,14 +63,83 @@ quint32 Crc32::hashSize()
     return m_hashSize;
 }
 
+std::unique_ptr<HashAlgorithm> Crc32::clone() const
+{
+    return std::make_unique<Crc32>(*this);
+}
+
+QString Crc32::name() const
+{
+    return (m_polynomial == CASTAGNOLI_POLYNOMIAL) ? QStringLiteral("crc32c") : QStringLiteral("crc32");
+}
+
+bool Crc32::isHardwareAccelerated() const
+{
+    return m_useHardware;
+}
+
+bool Crc32::hasHardwareCrc32c() Q_DECL_NOEXCEPT
+{
+#ifdef CRC32_HARDWARE_CRC32C
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void Crc32::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+
+    if (m_useHardware) {
+        m_hash = computeHardware(m_hash, current, static_cast<std::size_t>(count));
+    }
+    else {
+        m_hash = compute(*m_lookupTable, m_hash, current, static_cast<std::size_t>(count));
+    }
+}
+
+#ifdef CRC32_HARDWARE_CRC32C
+
+__attribute__((target("sse4.2")))
+quint32 Crc32::computeHardware(quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    quint64 crc = ~hash;
+    const quint8 *currentByte = reinterpret_cast<const quint8*>(data);
+
+    // Process 8 bytes per instruction.
+    while (length >= sizeof(quint64)) {
+        crc = _mm_crc32_u64(crc, common::from_unaligned<quint64>(currentByte));
+        currentByte += sizeof(quint64);
+        length -= sizeof(quint64);
+    }
+
+    quint32 crc32 = static_cast<quint32>(crc);
+    while (length-- != 0) {
+        crc32 = _mm_crc32_u8(crc32, *currentByte++);
+    }
+
+    return ~crc32;
+}
+
+#else
+
+quint32 Crc32::computeHardware(quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return compute(*sharedTable(CASTAGNOLI_POLYNOMIAL), hash, data, length);
+}
+
+#endif
+
 #ifdef CRC32_SLICING_BY_16
 
-void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+quint32 Crc32::compute(const LookupTable &table, quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
 {
-    quint32 crc = ~m_hash; // same as previousCrc32 ^ 0xFFFFFFFF
-    const quint8 *currentByte = reinterpret_cast<const quint8*>(data) + offset;
+    quint32 crc = ~hash; // same as previousCrc32 ^ 0xFFFFFFFF
+    const quint8 *currentByte = reinterpret_cast<const quint8*>(data);
     const quint32 *current = reinterpret_cast<const quint32*>(currentByte);
-    quint64 numBytes = count;
+    quint64 numBytes = length;
 
     // enabling optimization (at least -O2) automatically unrolls the inner for-loop
     const quint64 Unroll = 4;
@@ -65,43 +155,43 @@ void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count
           quint32 two   = *current++;
           quint32 three = *current++;
           quint32 four  = *current++;
-          crc  =  m_lookupTable[ 0][ four         & 0xFF] ^
-                  m_lookupTable[ 1][(four  >>  8) & 0xFF] ^
-                  m_lookupTable[ 2][(four  >> 16) & 0xFF] ^
-                  m_lookupTable[ 3][(four  >> 24) & 0xFF] ^
-                  m_lookupTable[ 4][ three        & 0xFF] ^
-                  m_lookupTable[ 5][(three >>  8) & 0xFF] ^
-                  m_lookupTable[ 6][(three >> 16) & 0xFF] ^
-                  m_lookupTable[ 7][(three >> 24) & 0xFF] ^
-                  m_lookupTable[ 8][ two          & 0xFF] ^
-                  m_lookupTable[ 9][(two   >>  8) & 0xFF] ^
-                  m_lookupTable[10][(two   >> 16) & 0xFF] ^
-                  m_lookupTable[11][(two   >> 24) & 0xFF] ^
-                  m_lookupTable[12][ one          & 0xFF] ^
-                  m_lookupTable[13][(one   >>  8) & 0xFF] ^
-                  m_lookupTable[14][(one   >> 16) & 0xFF] ^
-                  m_lookupTable[15][(one   >> 24) & 0xFF];
+          crc  =  table[ 0][ four         & 0xFF] ^
+                  table[ 1][(four  >>  8) & 0xFF] ^
+                  table[ 2][(four  >> 16) & 0xFF] ^
+                  table[ 3][(four  >> 24) & 0xFF] ^
+                  table[ 4][ three        & 0xFF] ^
+                  table[ 5][(three >>  8) & 0xFF] ^
+                  table[ 6][(three >> 16) & 0xFF] ^
+                  table[ 7][(three >> 24) & 0xFF] ^
+                  table[ 8][ two          & 0xFF] ^
+                  table[ 9][(two   >>  8) & 0xFF] ^
+                  table[10][(two   >> 16) & 0xFF] ^
+                  table[11][(two   >> 24) & 0xFF] ^
+                  table[12][ one          & 0xFF] ^
+                  table[13][(one   >>  8) & 0xFF] ^
+                  table[14][(one   >> 16) & 0xFF] ^
+                  table[15][(one   >> 24) & 0xFF];
         #else // Q_LITTLE_ENDIAN
           quint32 one   = *current++ ^ crc;
           quint32 two   = *current++;
           quint32 three = *current++;
           quint32 four  = *current++;
-          crc  =  m_lookupTable[ 0][(four  >> 24) & 0xFF] ^
-                  m_lookupTable[ 1][(four  >> 16) & 0xFF] ^
-                  m_lookupTable[ 2][(four  >>  8) & 0xFF] ^
-                  m_lookupTable[ 3][ four         & 0xFF] ^
-                  m_lookupTable[ 4][(three >> 24) & 0xFF] ^
-                  m_lookupTable[ 5][(three >> 16) & 0xFF] ^
-                  m_lookupTable[ 6][(three >>  8) & 0xFF] ^
-                  m_lookupTable[ 7][ three        & 0xFF] ^
-                  m_lookupTable[ 8][(two   >> 24) & 0xFF] ^
-                  m_lookupTable[ 9][(two   >> 16) & 0xFF] ^
-                  m_lookupTable[10][(two   >>  8) & 0xFF] ^
-                  m_lookupTable[11][ two          & 0xFF] ^
-                  m_lookupTable[12][(one   >> 24) & 0xFF] ^
-                  m_lookupTable[13][(one   >> 16) & 0xFF] ^
-                  m_lookupTable[14][(one   >>  8) & 0xFF] ^
-                  m_lookupTable[15][ one          & 0xFF];
+          crc  =  table[ 0][(four  >> 24) & 0xFF] ^
+                  table[ 1][(four  >> 16) & 0xFF] ^
+                  table[ 2][(four  >>  8) & 0xFF] ^
+                  table[ 3][ four         & 0xFF] ^
+                  table[ 4][(three >> 24) & 0xFF] ^
+                  table[ 5][(three >> 16) & 0xFF] ^
+                  table[ 6][(three >>  8) & 0xFF] ^
+                  table[ 7][ three        & 0xFF] ^
+                  table[ 8][(two   >> 24) & 0xFF] ^
+                  table[ 9][(two   >> 16) & 0xFF] ^
+                  table[10][(two   >>  8) & 0xFF] ^
+                  table[11][ two          & 0xFF] ^
+                  table[12][(one   >> 24) & 0xFF] ^
+                  table[13][(one   >> 16) & 0xFF] ^
+                  table[14][(one   >>  8) & 0xFF] ^
+                  table[15][ one          & 0xFF];
         #endif
       }
 
@@ -111,20 +201,20 @@ void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count
 
     // remaining 1 to 63 bytes (standard algorithm)
     while (numBytes-- != 0) {
-        crc = (crc >> 8) ^ m_lookupTable[0][(crc & 0xFF) ^ *currentByte++];
+        crc = (crc >> 8) ^ table[0][(crc & 0xFF) ^ *currentByte++];
     }
 
-    m_hash = ~crc;
+    return ~crc;
 }
 
 #elif defined(CRC32_SLICING_BY_8)
 
-void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+quint32 Crc32::compute(const LookupTable &table, quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
 {
-    quint32 crc = ~m_hash; // same as previousCrc32 ^ 0xFFFFFFFF
-    const quint8 *currentByte = reinterpret_cast<const quint8*>(data) + offset;
+    quint32 crc = ~hash; // same as previousCrc32 ^ 0xFFFFFFFF
+    const quint8 *currentByte = reinterpret_cast<const quint8*>(data);
     const quint32 *current = reinterpret_cast<const quint32*>(currentByte);
-    quint64 numBytes = count;
+    quint64 numBytes = length;
 
     // enabling optimization (at least -O2) automatically unrolls the inner for-loop
     const quint64 Unroll = 4;
@@ -138,25 +228,25 @@ void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count
         #if Q_BYTE_ORDER == Q_BIG_ENDIAN
           quint32 one   = *current++ ^ common::swap<quint32>(crc);
           quint32 two   = *current++;
-          crc = m_lookupTable[0][ two      & 0xFF] ^
-                m_lookupTable[1][(two>> 8) & 0xFF] ^
-                m_lookupTable[2][(two>>16) & 0xFF] ^
-                m_lookupTable[3][(two>>24) & 0xFF] ^
-                m_lookupTable[4][ one      & 0xFF] ^
-                m_lookupTable[5][(one>> 8) & 0xFF] ^
-                m_lookupTable[6][(one>>16) & 0xFF] ^
-                m_lookupTable[7][(one>>24) & 0xFF];
+          crc = table[0][ two      & 0xFF] ^
+                table[1][(two>> 8) & 0xFF] ^
+                table[2][(two>>16) & 0xFF] ^
+                table[3][(two>>24) & 0xFF] ^
+                table[4][ one      & 0xFF] ^
+                table[5][(one>> 8) & 0xFF] ^
+                table[6][(one>>16) & 0xFF] ^
+                table[7][(one>>24) & 0xFF];
         #else // Q_LITTLE_ENDIAN
           quint32 one   = *current++ ^ crc;
           quint32 two   = *current++;
-          crc = m_lookupTable[0][(two>>24) & 0xFF] ^
-                m_lookupTable[1][(two>>16) & 0xFF] ^
-                m_lookupTable[2][(two>> 8) & 0xFF] ^
-                m_lookupTable[3][ two      & 0xFF] ^
-                m_lookupTable[4][(one>>24) & 0xFF] ^
-                m_lookupTable[5][(one>>16) & 0xFF] ^
-                m_lookupTable[6][(one>> 8) & 0xFF] ^
-                m_lookupTable[7][ one      & 0xFF];
+          crc = table[0][(two>>24) & 0xFF] ^
+                table[1][(two>>16) & 0xFF] ^
+                table[2][(two>> 8) & 0xFF] ^
+                table[3][ two      & 0xFF] ^
+                table[4][(one>>24) & 0xFF] ^
+                table[5][(one>>16) & 0xFF] ^
+                table[6][(one>> 8) & 0xFF] ^
+                table[7][ one      & 0xFF];
         #endif
       }
 
@@ -166,20 +256,20 @@ void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count
 
     // remaining 1 to 63 bytes (standard algorithm)
     while (numBytes-- != 0) {
-        crc = (crc >> 8) ^ m_lookupTable[0][(crc & 0xFF) ^ *currentByte++];
+        crc = (crc >> 8) ^ table[0][(crc & 0xFF) ^ *currentByte++];
     }
 
-    m_hash = ~crc;
+    return ~crc;
 }
 
 #elif defined(CRC32_SLICING_BY_4)
 
-void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+quint32 Crc32::compute(const LookupTable &table, quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
 {
-    quint32 crc = ~m_hash; // same as previousCrc32 ^ 0xFFFFFFFF
-    const quint8 *currentByte = reinterpret_cast<const quint8*>(data) + offset;
+    quint32 crc = ~hash; // same as previousCrc32 ^ 0xFFFFFFFF
+    const quint8 *currentByte = reinterpret_cast<const quint8*>(data);
     const quint32 *current = reinterpret_cast<const quint32*>(currentByte);
-    quint64 numBytes = count;
+    quint64 numBytes = length;
 
     // enabling optimization (at least -O2) automatically unrolls the inner for-loop
     const quint64 Unroll = 4;
@@ -192,16 +282,16 @@ void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count
       {
         #if Q_BYTE_ORDER == Q_BIG_ENDIAN
           quint32 one   = *current++ ^ common::swap<quint32>(crc);
-          crc = m_lookupTable[0][ one      & 0xFF] ^
-                m_lookupTable[1][(one>> 8) & 0xFF] ^
-                m_lookupTable[2][(one>>16) & 0xFF] ^
-                m_lookupTable[3][(one>>24) & 0xFF];
+          crc = table[0][ one      & 0xFF] ^
+                table[1][(one>> 8) & 0xFF] ^
+                table[2][(one>>16) & 0xFF] ^
+                table[3][(one>>24) & 0xFF];
         #else // Q_LITTLE_ENDIAN
           quint32 one   = *current++ ^ crc;
-          crc = m_lookupTable[0][(one>>24) & 0xFF] ^
-                m_lookupTable[1][(one>>16) & 0xFF] ^
-                m_lookupTable[2][(one>> 8) & 0xFF] ^
-                m_lookupTable[3][ one      & 0xFF];
+          crc = table[0][(one>>24) & 0xFF] ^
+                table[1][(one>>16) & 0xFF] ^
+                table[2][(one>> 8) & 0xFF] ^
+                table[3][ one      & 0xFF];
         #endif
       }
 
@@ -211,46 +301,125 @@ void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count
 
     // remaining 1 to 63 bytes (standard algorithm)
     while (numBytes-- != 0) {
-        crc = (crc >> 8) ^ m_lookupTable[0][(crc & 0xFF) ^ *currentByte++];
+        crc = (crc >> 8) ^ table[0][(crc & 0xFF) ^ *currentByte++];
     }
 
-    m_hash = ~crc;
+    return ~crc;
 }
 
 #else // Default 1 byte table lookup.
 
-void Crc32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+quint32 Crc32::compute(const LookupTable &table, quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
 {
-    quint32 crc = ~m_hash; // same as previousCrc32 ^ 0xFFFFFFFF
-    const quint8 *currentByte = reinterpret_cast<const quint8*>(data) + offset;
-    quint64 numBytes = count;
+    quint32 crc = ~hash; // same as previousCrc32 ^ 0xFFFFFFFF
+    const quint8 *currentByte = reinterpret_cast<const quint8*>(data);
+    quint64 numBytes = length;
 
     while (numBytes-- != 0) {
-        crc = (crc >> 8) ^ m_lookupTable[0][(crc & 0xFF) ^ *currentByte++];
+        crc = (crc >> 8) ^ table[0][(crc & 0xFF) ^ *currentByte++];
     }
 
-    m_hash = ~crc;
+    return ~crc;
 }
 
 #endif
 
-QByteArray Crc32::hashFinal()
+bool Crc32::isCombinable() const
+{
+    return true;
+}
+
+void Crc32::combineCore(const HashAlgorithm &next, quint64 nextLength)
+{
+    const Crc32 *other = dynamic_cast<const Crc32*>(&next);
+    if ((other == nullptr) || (other->m_polynomial != m_polynomial)) {
+        throw QString("Algorithms can't be combined.");
+    }
+
+    // The register is linear in its start value: running next's data from this register gives
+    // next's register, plus the difference between the two start values carried over the data.
+    const ZeroRunOperator<quint32> &zeros = zeroOperator();
+    m_hash = ~(zeros.apply(~m_hash, nextLength) ^ ~other->m_hash ^ zeros.apply(~other->m_seed, nextLength));
+}
+
+void Crc32::hashZeros(qint64 count)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    // The operator works on the register, which holds the inverted CRC.
+    m_hash = ~zeroOperator().apply(~m_hash, static_cast<quint64>(count));
 }
 
-void Crc32::initializeTable()
+const ZeroRunOperator<quint32> &Crc32::zeroOperator()
 {
+    // Process wide operators for the well known polynomials.
+    if (m_polynomial == DEFAULT_POLYNOMIAL32) {
+        static const ZeroRunOperator<quint32> defaultOperator(DEFAULT_POLYNOMIAL32);
+        return defaultOperator;
+    }
+    if (m_polynomial == CASTAGNOLI_POLYNOMIAL) {
+        static const ZeroRunOperator<quint32> castagnoliOperator(CASTAGNOLI_POLYNOMIAL);
+        return castagnoliOperator;
+    }
+
+    if (!m_ownedZeroOperator) {
+        m_ownedZeroOperator = std::make_shared<const ZeroRunOperator<quint32>>(m_polynomial);
+    }
+
+    return *m_ownedZeroOperator;
+}
+
+void Crc32::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint32>(m_hash, hash);
+}
+
+void Crc32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_polynomial);
+    writer.write(m_hash);
+}
+
+bool Crc32::readState(io::BinaryReader &reader)
+{
+    // The lookup table depends on the polynomial, so it has to match.
+    if (reader.readUInt32() != m_polynomial) {
+        return false;
+    }
+
+    m_hash = reader.readUInt32();
+    return true;
+}
+
+const Crc32::LookupTable &Crc32::defaultTable()
+{
+    // Built once on first use, thread-safe since C++11.
+    static const LookupTable table = makeTable(DEFAULT_POLYNOMIAL32);
+    return table;
+}
+
+const Crc32::LookupTable *Crc32::sharedTable(quint32 polynomial)
+{
+    if (polynomial == DEFAULT_POLYNOMIAL32) {
+        return &defaultTable();
+    }
+    if (polynomial == CASTAGNOLI_POLYNOMIAL) {
+        static const LookupTable table = makeTable(CASTAGNOLI_POLYNOMIAL);
+        return &table;
+    }
+
+    return nullptr;
+}
+
+Crc32::LookupTable Crc32::makeTable(quint32 polynomial)
+{
+    LookupTable table;
     quint32 entry;
     for (quint32 i = 0; i < TableEntries; ++i) {
         entry = i;
         for (auto j = 0; j < 8; ++j) {
-            entry = (entry >> 1) ^ ((entry & 1) * m_polynomial);
+            entry = (entry >> 1) ^ ((entry & 1) * polynomial);
         }
 
-        m_lookupTable[0][i] = entry;
+        table[0][i] = entry;
     }
 
     if (MaxSlice > 1) {
@@ -258,11 +427,13 @@ void Crc32::initializeTable()
         {
             for (quint32 slice = 1; slice < MaxSlice; ++slice)
             {
-                m_lookupTable[slice][i] =
-                        (m_lookupTable[slice - 1][i] >> 8) ^ m_lookupTable[0][m_lookupTable[slice - 1][i] & 0xFF];
+                table[slice][i] =
+                        (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
             }
         }
     }
+
+    return table;
 }
 
 } // namespace crc
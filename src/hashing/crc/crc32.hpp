@@ -23,6 +23,7 @@
 #define CRC32_HPP
 
 #include "../hashalgorithm.hpp"
+#include "zerorunoperator.hpp"
 #include <array>
 #include <cstdint>
 
@@ -31,6 +32,9 @@ namespace qkeeg { namespace hashing { namespace crc {
 // zlib's CRC32 polynomial
 #define ZLIB_POLYNOMIAL UINT32_C(0xEDB88320)
 
+// Castagnoli's CRC32C polynomial, used by iSCSI, ext4 and the SSE 4.2 crc32 instruction.
+#define CASTAGNOLI_POLYNOMIAL UINT32_C(0x82F63B78)
+
 // If a polynomial isn't provided, default to zlib's.
 #ifndef DEFAULT_POLYNOMIAL32
     #define DEFAULT_POLYNOMIAL32 ZLIB_POLYNOMIAL
@@ -44,14 +48,29 @@ public:
     //! Constructor
     Crc32(const quint32 &polynomial = DEFAULT_POLYNOMIAL32, const quint32 &seed = UINT32_C(0));
 
+    //! One-shot CRC32 with the default polynomial. No heap allocation, no exceptions, reentrant.
+    static quint32 hash(const void *data, std::size_t length, quint32 seed = 0) Q_DECL_NOEXCEPT;
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
+    virtual bool isCombinable() const override;
+
+    //! True if this instance uses the CPU's CRC32C instruction instead of the lookup table.
+    bool isHardwareAccelerated() const;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    //! Advances over the zeros in O(log count) instead of hashing them.
+    virtual void hashZeros(qint64 count) override;
+    //! Needs the same polynomial.
+    virtual void combineCore(const HashAlgorithm &next, quint64 nextLength) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     #ifdef CRC32_SLICING_BY_16
@@ -66,13 +85,27 @@ private:
     static const quint32 TableEntries  = UINT32_C(256);
     static const quint32 m_hashSize    = std::numeric_limits<quint32>::digits;
 
+    using LookupTable = std::array<std::array<quint32, TableEntries>, MaxSlice>;
+
     //! CRC32 polynomial
     quint32 m_polynomial;
     quint32 m_seed;
     quint32 m_hash;
-    std::array<std::array<quint32, TableEntries>, MaxSlice> m_lookupTable;
+    //! Points at the shared default table, or at m_ownedTable for a custom polynomial.
+    const LookupTable *m_lookupTable;
+    std::shared_ptr<const LookupTable> m_ownedTable;
+    //! Built on first use, shared by copies made after that.
+    std::shared_ptr<const ZeroRunOperator<quint32>> m_ownedZeroOperator;
+    bool m_useHardware;
 
-    void initializeTable();
+    static const LookupTable &defaultTable();
+    const ZeroRunOperator<quint32> &zeroOperator();
+    //! Process wide table for the well known polynomials, nullptr for any other.
+    static const LookupTable *sharedTable(quint32 polynomial);
+    static LookupTable makeTable(quint32 polynomial);
+    static quint32 compute(const LookupTable &table, quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT;
+    static bool hasHardwareCrc32c() Q_DECL_NOEXCEPT;
+    static quint32 computeHardware(quint32 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT;
 };
 
 } // namespace crc
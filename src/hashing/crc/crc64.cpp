@@ -21,6 +21,8 @@
  */
 #include "crc64.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace crc {
 
@@ -28,7 +30,20 @@ Crc64::Crc64(const quint64 &polynomial, const quint64 &seed) : HashAlgorithm(),
     m_polynomial(polynomial), m_seed(seed)
 {
     initialize();
-    initializeTable();
+
+    // Only a custom polynomial needs its own table, copies of this instance share it.
+    if (m_polynomial == DEFAULT_POLYNOMIAL64) {
+        m_lookupTable = &defaultTable();
+    }
+    else {
+        m_ownedTable = std::make_shared<const LookupTable>(makeTable(m_polynomial));
+        m_lookupTable = m_ownedTable.get();
+    }
+}
+
+quint64 Crc64::hash(const void *data, std::size_t length, quint64 seed) Q_DECL_NOEXCEPT
+{
+    return compute(defaultTable(), seed, data, length);
 }
 
 void Crc64::initialize()
@@ -42,12 +57,28 @@ quint32 Crc64::hashSize()
     return m_hashSize;
 }
 
-void Crc64::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Crc64::clone() const
+{
+    return std::make_unique<Crc64>(*this);
+}
+
+QString Crc64::name() const
+{
+    return QStringLiteral("crc64");
+}
+
+void Crc64::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    m_hash = compute(*m_lookupTable, m_hash, reinterpret_cast<const quint8*>(data) + offset,
+                     static_cast<std::size_t>(count));
+}
+
+quint64 Crc64::compute(const LookupTable &table, quint64 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT
 {
-    quint64 crc = ~m_hash; // same as previousCrc64 ^ 0xFFFFFFFFFFFFFFFF
-    const quint8 *currentByte = reinterpret_cast<const uint8_t*>(data) + offset;
-    const quint64 *current = reinterpret_cast<const uint64_t*>(currentByte);
-    quint64 numBytes = count;
+    quint64 crc = ~hash; // same as previousCrc64 ^ 0xFFFFFFFFFFFFFFFF
+    const quint8 *currentByte = reinterpret_cast<const quint8*>(data);
+    const quint64 *current = reinterpret_cast<const quint64*>(currentByte);
+    quint64 numBytes = length;
 
     // enabling optimization (at least -O2) automatically unrolls the inner for-loop
     const quint64 Unroll = 4;
@@ -60,24 +91,24 @@ void Crc64::hashCore(const void *data, const qint64 &offset, const qint64 &count
       {
         #if Q_BYTE_ORDER == Q_BIG_ENDIAN
           quint64 one   = *current++ ^ common::swap<quint64>(crc);
-          crc = m_lookupTable[0][ one      & 0xFF] ^
-                m_lookupTable[1][(one >>  8) & 0xFF] ^
-                m_lookupTable[2][(one >> 16) & 0xFF] ^
-                m_lookupTable[3][(one >> 24) & 0xFF] ^
-                m_lookupTable[4][(one >> 32) & 0xFF] ^
-                m_lookupTable[5][(one >> 40) & 0xFF] ^
-                m_lookupTable[6][(one >> 48) & 0xFF] ^
-                m_lookupTable[7][(one >> 56) & 0xFF];
+          crc = table[0][ one      & 0xFF] ^
+                table[1][(one >>  8) & 0xFF] ^
+                table[2][(one >> 16) & 0xFF] ^
+                table[3][(one >> 24) & 0xFF] ^
+                table[4][(one >> 32) & 0xFF] ^
+                table[5][(one >> 40) & 0xFF] ^
+                table[6][(one >> 48) & 0xFF] ^
+                table[7][(one >> 56) & 0xFF];
         #else // Q_LITTLE_ENDIAN
           quint64 one   = *current++ ^ crc;
-          crc = m_lookupTable[0][(one >> 56) & 0xFF] ^
-                m_lookupTable[1][(one >> 48) & 0xFF] ^
-                m_lookupTable[2][(one >> 40) & 0xFF] ^
-                m_lookupTable[3][(one >> 32) & 0xFF] ^
-                m_lookupTable[4][(one >> 24) & 0xFF] ^
-                m_lookupTable[5][(one >> 16) & 0xFF] ^
-                m_lookupTable[6][(one >>  8) & 0xFF] ^
-                m_lookupTable[7][ one      & 0xFF];
+          crc = table[0][(one >> 56) & 0xFF] ^
+                table[1][(one >> 48) & 0xFF] ^
+                table[2][(one >> 40) & 0xFF] ^
+                table[3][(one >> 32) & 0xFF] ^
+                table[4][(one >> 24) & 0xFF] ^
+                table[5][(one >> 16) & 0xFF] ^
+                table[6][(one >>  8) & 0xFF] ^
+                table[7][ one      & 0xFF];
         #endif
       }
 
@@ -87,17 +118,105 @@ void Crc64::hashCore(const void *data, const qint64 &offset, const qint64 &count
 
     // remaining 1 to 63 bytes (standard algorithm)
     while (numBytes-- != 0) {
-        crc = (crc >> 8) ^ m_lookupTable[0][(crc & 0xFF) ^ *currentByte++];
+        crc = (crc >> 8) ^ table[0][(crc & 0xFF) ^ *currentByte++];
+    }
+
+    return ~crc;
+}
+
+bool Crc64::isCombinable() const
+{
+    return true;
+}
+
+void Crc64::combineCore(const HashAlgorithm &next, quint64 nextLength)
+{
+    const Crc64 *other = dynamic_cast<const Crc64*>(&next);
+    if ((other == nullptr) || (other->m_polynomial != m_polynomial)) {
+        throw QString("Algorithms can't be combined.");
+    }
+
+    // The register is linear in its start value: running next's data from this register gives
+    // next's register, plus the difference between the two start values carried over the data.
+    const ZeroRunOperator<quint64> &zeros = zeroOperator();
+    m_hash = ~(zeros.apply(~m_hash, nextLength) ^ ~other->m_hash ^ zeros.apply(~other->m_seed, nextLength));
+}
+
+void Crc64::hashZeros(qint64 count)
+{
+    // The operator works on the register, which holds the inverted CRC.
+    m_hash = ~zeroOperator().apply(~m_hash, static_cast<quint64>(count));
+}
+
+const ZeroRunOperator<quint64> &Crc64::zeroOperator()
+{
+    // Process wide operator for the default polynomial.
+    if (m_polynomial == DEFAULT_POLYNOMIAL64) {
+        static const ZeroRunOperator<quint64> defaultOperator(DEFAULT_POLYNOMIAL64);
+        return defaultOperator;
+    }
+
+    if (!m_ownedZeroOperator) {
+        m_ownedZeroOperator = std::make_shared<const ZeroRunOperator<quint64>>(m_polynomial);
+    }
+
+    return *m_ownedZeroOperator;
+}
+
+void Crc64::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint64>(m_hash, hash);
+}
+
+void Crc64::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_polynomial);
+    writer.write(m_hash);
+}
+
+bool Crc64::readState(io::BinaryReader &reader)
+{
+    // The lookup table depends on the polynomial, so it has to match.
+    if (reader.readUInt64() != m_polynomial) {
+        return false;
     }
 
-    m_hash = ~crc;
+    m_hash = reader.readUInt64();
+    return true;
 }
 
-QByteArray Crc64::hashFinal()
+const Crc64::LookupTable &Crc64::defaultTable()
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint64>(m_hash, buffer.data());
-    return buffer;
+    // Built once on first use, thread-safe since C++11.
+    static const LookupTable table = makeTable(DEFAULT_POLYNOMIAL64);
+    return table;
+}
+
+Crc64::LookupTable Crc64::makeTable(quint64 polynomial)
+{
+    LookupTable table;
+    quint64 entry;
+    for (quint32 i = 0; i < TableEntries; ++i) {
+        entry = i;
+        for (auto j = 0; j < 8; ++j) {
+            entry = (entry >> 1) ^ ((entry & 1) * polynomial);
+        }
+
+        table[0][i] = entry;
+    }
+
+    if (MaxSlice > 1) {
+        for (quint32 i = 0; i < TableEntries; ++i)
+        {
+            for (quint32 slice = 1; slice < MaxSlice; ++slice)
+            {
+                table[slice][i] =
+                        (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    return table;
 }
 
 } // namespace crc
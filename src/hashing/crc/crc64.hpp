@@ -23,6 +23,7 @@
 #define CRC64_HPP
 
 #include "../hashalgorithm.hpp"
+#include "zerorunoperator.hpp"
 #include <array>
 
 namespace qkeeg { namespace hashing { namespace crc {
@@ -46,27 +47,48 @@ class Crc64 : public HashAlgorithm
 public:
     Crc64(const quint64 &polynomial = DEFAULT_POLYNOMIAL64, const quint64 &seed = UINT32_C(0));
 
+    //! One-shot CRC64 with the default polynomial. No heap allocation, no exceptions, reentrant.
+    static quint64 hash(const void *data, std::size_t length, quint64 seed = 0) Q_DECL_NOEXCEPT;
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
+    virtual bool isCombinable() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    //! Advances over the zeros in O(log count) instead of hashing them.
+    virtual void hashZeros(qint64 count) override;
+    //! Needs the same polynomial.
+    virtual void combineCore(const HashAlgorithm &next, quint64 nextLength) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 MaxSlice = UINT32_C(8);
     static const quint32 TableEntries = UINT32_C(256);
-    static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
+    static const quint32 m_hashSize = std::numeric_limits<quint64>::digits;
+
+    using LookupTable = std::array<std::array<quint64, TableEntries>, MaxSlice>;
 
     //! CRC64 polynomial
     quint64 m_polynomial;
     quint64 m_seed;
     quint64 m_hash;
-    std::array<std::array<quint64, TableEntries>, MaxSlice> m_lookupTable;
+    //! Points at the shared default table, or at m_ownedTable for a custom polynomial.
+    const LookupTable *m_lookupTable;
+    std::shared_ptr<const LookupTable> m_ownedTable;
+    //! Built on first use, shared by copies made after that.
+    std::shared_ptr<const ZeroRunOperator<quint64>> m_ownedZeroOperator;
 
-    void initializeTable();
+    static const LookupTable &defaultTable();
+    const ZeroRunOperator<quint64> &zeroOperator();
+    static LookupTable makeTable(quint64 polynomial);
+    static quint64 compute(const LookupTable &table, quint64 hash, const void *data, std::size_t length) Q_DECL_NOEXCEPT;
 };
 
 } // namespace crc
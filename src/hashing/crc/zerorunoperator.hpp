@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef ZERORUNOPERATOR_HPP
+#define ZERORUNOPERATOR_HPP
+
+#include <QtGlobal>
+#include <array>
+#include <limits>
+
+namespace qkeeg { namespace hashing { namespace crc {
+
+//! Advances a reflected CRC register over a run of zero bytes in O(log n), without touching them.
+//! Appending zeros is linear over GF(2), so the operator for 2^k zero bytes is a bit matrix; the
+//! powers are built once and the ones matching the bits of the run length are applied in turn.
+template<typename T>
+class ZeroRunOperator
+{
+public:
+    explicit ZeroRunOperator(T polynomial)
+    {
+        // One zero bit: the register shifts right and the polynomial is added if the low bit was set.
+        Matrix bit;
+        bit[0] = polynomial;
+        for (int i = 1; i < Width; ++i) {
+            bit[i] = T(1) << (i - 1);
+        }
+
+        // 2, 4, then 8 bits.
+        m_powers[0] = square(square(square(bit)));
+        for (int k = 1; k < Powers; ++k) {
+            m_powers[k] = square(m_powers[k - 1]);
+        }
+    }
+
+    //! Register value after count zero bytes. Works on the register, i.e. the inverted CRC.
+    T apply(T crc, quint64 count) const Q_DECL_NOEXCEPT
+    {
+        for (int k = 0; count != 0; ++k, count >>= 1) {
+            if ((count & 1) != 0) {
+                crc = multiply(m_powers[k], crc);
+            }
+        }
+
+        return crc;
+    }
+
+private:
+    static const int Width  = std::numeric_limits<T>::digits;
+    static const int Powers = std::numeric_limits<quint64>::digits;
+
+    //! Column i is the image of bit i.
+    using Matrix = std::array<T, Width>;
+
+    static T multiply(const Matrix &matrix, T vector) Q_DECL_NOEXCEPT
+    {
+        T result = 0;
+        for (int i = 0; vector != 0; ++i, vector >>= 1) {
+            if ((vector & 1) != 0) {
+                result ^= matrix[i];
+            }
+        }
+
+        return result;
+    }
+
+    static Matrix square(const Matrix &matrix) Q_DECL_NOEXCEPT
+    {
+        Matrix result;
+        for (int i = 0; i < Width; ++i) {
+            result[i] = multiply(matrix, matrix[i]);
+        }
+
+        return result;
+    }
+
+    //! m_powers[k] appends 2^k zero bytes.
+    std::array<Matrix, Powers> m_powers;
+};
+
+} // namespace crc
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // ZERORUNOPERATOR_HPP
@@ -21,6 +21,8 @@
  */
 #include "keccak.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 #include "../../common/enums.hpp"
 #include <algorithm>
 
@@ -78,6 +80,13 @@ Keccak::~Keccak()
     std::fill(m_hash.begin(), m_hash.end(), 0);
 }
 
+void Keccak::hash(const void *data, std::size_t length, void *out, Bits bits) Q_DECL_NOEXCEPT
+{
+    Keccak algorithm(bits);
+    algorithm.hashCore(data, 0, static_cast<qint64>(length));
+    algorithm.hashFinalInto(out);
+}
+
 void Keccak::initialize()
 {
     std::fill(m_hash.begin(), m_hash.end(), UINT64_C(0));
@@ -91,7 +100,17 @@ quint32 Keccak::hashSize()
     return static_cast<quint32>(enumToIntegral(m_bits));
 }
 
-void Keccak::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Keccak::clone() const
+{
+    return std::make_unique<Keccak>(*this);
+}
+
+QString Keccak::name() const
+{
+    return QStringLiteral("keccak-%1").arg(enumToIntegral(m_bits));
+}
+
+void Keccak::hashCore(const void *data, qint64 offset, qint64 count)
 {
     const quint8 *current = static_cast<const quint8*>(data) + offset;
     quint64 numBytes = count;
@@ -131,21 +150,20 @@ void Keccak::hashCore(const void *data, const qint64 &offset, const qint64 &coun
     }
 }
 
-QByteArray Keccak::hashFinal()
+void Keccak::hashFinalInto(void *hash)
 {
     // process remaining bytes
     processBuffer();
 
     // number of significant elements in hash (uint64_t)
     quint32 hashLength = hashSize() / 64;
-    QByteArray buffer;
-    buffer.reserve(hashSize() / sizeof(quint8));
+    quint8 *current = reinterpret_cast<quint8*>(hash);
 
     for (quint32 i = 0; i < hashLength; ++i)
     {
         for (quint32 j = 0; j < 8; ++j)
         {
-            buffer.append(static_cast<char>((m_hash[i] >> (8 * j)) & 0xFF));
+            *current++ = static_cast<quint8>((m_hash[i] >> (8 * j)) & 0xFF);
         }
     }
 
@@ -154,11 +172,35 @@ QByteArray Keccak::hashFinal()
     quint32 processed = 0;
     while (processed < remainder)
     {
-        buffer.append(static_cast<char>(m_hash[hashLength] >> processed));
+        *current++ = static_cast<quint8>(m_hash[hashLength] >> processed);
         processed += 8;
     }
+}
+
+void Keccak::writeState(io::BinaryWriter &writer) const
+{
+    for (const auto &hash : m_hash) {
+        writer.write(hash);
+    }
+    writer.write(static_cast<quint64>(m_numBytes));
+    writer.write(static_cast<quint64>(m_bufferSize));
+    writer.write(QByteArray::fromRawData(reinterpret_cast<const char*>(m_buffer.data()), static_cast<int>(m_bufferSize)));
+}
+
+bool Keccak::readState(io::BinaryReader &reader)
+{
+    for (auto &hash : m_hash) {
+        hash = reader.readUInt64();
+    }
+    m_numBytes   = reader.readUInt64();
+    m_bufferSize = reader.readUInt64();
+    if (m_bufferSize >= m_blockSize) {
+        return false;
+    }
 
-    return buffer;
+    QByteArray buffer = reader.readBytes(static_cast<qint32>(m_bufferSize));
+    std::copy(buffer.constBegin(), buffer.constEnd(), m_buffer.begin());
+    return buffer.size() == static_cast<qint32>(m_bufferSize);
 }
 
 void Keccak::processBlock(const void *data)
@@ -21,6 +21,9 @@
  */
 #include "md5.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
+#include <algorithm>
 
 namespace qkeeg { namespace hashing { namespace cryptographic {
 
@@ -70,6 +73,13 @@ Md5::~Md5()
     std::fill(m_hash.begin(), m_hash.end(), 0);
 }
 
+void Md5::hash(const void *data, std::size_t length, void *out) Q_DECL_NOEXCEPT
+{
+    Md5 algorithm;
+    algorithm.hashCore(data, 0, static_cast<qint64>(length));
+    algorithm.hashFinalInto(out);
+}
+
 void Md5::initialize()
 {
     m_numBytes   = 0;
@@ -89,7 +99,17 @@ quint32 Md5::hashSize()
     return m_hashSize;
 }
 
-void Md5::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Md5::clone() const
+{
+    return std::make_unique<Md5>(*this);
+}
+
+QString Md5::name() const
+{
+    return QStringLiteral("md5");
+}
+
+void Md5::hashCore(const void *data, qint64 offset, qint64 count)
 {
     const quint8* current = reinterpret_cast<const quint8*>(data) + offset;
     qint64 numBytes = count;
@@ -128,7 +148,7 @@ void Md5::hashCore(const void *data, const qint64 &offset, const qint64 &count)
     }
 }
 
-QByteArray Md5::hashFinal()
+void Md5::hashFinalInto(void *hash)
 {
     // save old hash if buffer is partially filled
     std::array<quint32, NUM_HASH_VALUES> oldHash{m_hash};
@@ -136,16 +156,40 @@ QByteArray Md5::hashFinal()
     // process remaining bytes
     processBuffer();
 
-    QByteArray buffer(m_hashSize / 8, char(0));
-    qkeeg::common::int_to_bytes_little(m_hash[0], buffer.data());
-    qkeeg::common::int_to_bytes_little(m_hash[1], buffer.data()+4);
-    qkeeg::common::int_to_bytes_little(m_hash[2], buffer.data()+8);
-    qkeeg::common::int_to_bytes_little(m_hash[3], buffer.data()+12);
+    quint8 *current = reinterpret_cast<quint8*>(hash);
+    qkeeg::common::int_to_bytes_little(m_hash[0], current);
+    qkeeg::common::int_to_bytes_little(m_hash[1], current+4);
+    qkeeg::common::int_to_bytes_little(m_hash[2], current+8);
+    qkeeg::common::int_to_bytes_little(m_hash[3], current+12);
 
     // restore old hash
     std::copy(oldHash.begin(), oldHash.end(), m_hash.begin());
+}
+
+void Md5::writeState(io::BinaryWriter &writer) const
+{
+    for (const auto &hash : m_hash) {
+        writer.write(hash);
+    }
+    writer.write(static_cast<quint64>(m_numBytes));
+    writer.write(static_cast<quint64>(m_bufferSize));
+    writer.write(QByteArray::fromRawData(reinterpret_cast<const char*>(m_buffer.data()), static_cast<int>(m_bufferSize)));
+}
+
+bool Md5::readState(io::BinaryReader &reader)
+{
+    for (auto &hash : m_hash) {
+        hash = reader.readUInt32();
+    }
+    m_numBytes   = reader.readUInt64();
+    m_bufferSize = reader.readUInt64();
+    if (m_bufferSize >= BLOCK_SIZE) {
+        return false;
+    }
 
-    return buffer;
+    QByteArray buffer = reader.readBytes(static_cast<qint32>(m_bufferSize));
+    std::copy(buffer.constBegin(), buffer.constEnd(), m_buffer.begin());
+    return buffer.size() == static_cast<qint32>(m_bufferSize);
 }
 
 void Md5::processBlock(const void *data)
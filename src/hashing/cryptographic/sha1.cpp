@@ -21,6 +21,9 @@
  */
 #include "sha1.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
+#include <algorithm>
 
 namespace qkeeg { namespace hashing { namespace cryptographic {
 
@@ -61,6 +64,13 @@ Sha1::~Sha1()
     std::fill(m_hash.begin(), m_hash.end(), 0);
 }
 
+void Sha1::hash(const void *data, std::size_t length, void *out) Q_DECL_NOEXCEPT
+{
+    Sha1 algorithm;
+    algorithm.hashCore(data, 0, static_cast<qint64>(length));
+    algorithm.hashFinalInto(out);
+}
+
 void Sha1::initialize()
 {
     m_hashValue.clear();
@@ -80,7 +90,17 @@ quint32 Sha1::hashSize()
     return m_hashSize;
 }
 
-void Sha1::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Sha1::clone() const
+{
+    return std::make_unique<Sha1>(*this);
+}
+
+QString Sha1::name() const
+{
+    return QStringLiteral("sha1");
+}
+
+void Sha1::hashCore(const void *data, qint64 offset, qint64 count)
 {
     const quint8* current = reinterpret_cast<const quint8*>(data) + offset;
     quint64 numBytes = count;
@@ -119,7 +139,7 @@ void Sha1::hashCore(const void *data, const qint64 &offset, const qint64 &count)
     }
 }
 
-QByteArray Sha1::hashFinal()
+void Sha1::hashFinalInto(void *hash)
 {
     // save old hash if buffer is partially filled
     std::array<quint32, NUM_HASH_VALUES> oldHash{m_hash};
@@ -127,15 +147,39 @@ QByteArray Sha1::hashFinal()
     // process remaining bytes
     processBuffer();
 
-    QByteArray buffer(m_hashSize/std::numeric_limits<quint8>::digits, char(0));
+    quint8 *current = reinterpret_cast<quint8*>(hash);
     for (quint32 i = 0; i < m_hash.size(); ++i) {
-        qkeeg::common::int_to_bytes_big<quint32>(m_hash[i], buffer.data() + i * sizeof(quint32));
+        qkeeg::common::int_to_bytes_big<quint32>(m_hash[i], current + i * sizeof(quint32));
     }
 
     // restore old hash
     std::copy(oldHash.begin(), oldHash.end(), m_hash.begin());
+}
+
+void Sha1::writeState(io::BinaryWriter &writer) const
+{
+    for (const auto &hash : m_hash) {
+        writer.write(hash);
+    }
+    writer.write(static_cast<quint64>(m_numBytes));
+    writer.write(static_cast<quint64>(m_bufferSize));
+    writer.write(QByteArray::fromRawData(reinterpret_cast<const char*>(m_buffer.data()), static_cast<int>(m_bufferSize)));
+}
+
+bool Sha1::readState(io::BinaryReader &reader)
+{
+    for (auto &hash : m_hash) {
+        hash = reader.readUInt32();
+    }
+    m_numBytes   = reader.readUInt64();
+    m_bufferSize = reader.readUInt64();
+    if (m_bufferSize >= BLOCK_SIZE) {
+        return false;
+    }
 
-    return buffer;
+    QByteArray buffer = reader.readBytes(static_cast<qint32>(m_bufferSize));
+    std::copy(buffer.constBegin(), buffer.constEnd(), m_buffer.begin());
+    return buffer.size() == static_cast<qint32>(m_bufferSize);
 }
 
 void Sha1::processBlock(const void *data)
@@ -35,14 +35,21 @@ public:
     Sha256();
     virtual ~Sha256();
 
+    //! One-shot hash of a buffer into out, hashSize() / 8 bytes. No heap allocation, no exceptions, reentrant.
+    static void hash(const void *data, std::size_t length, void *out) Q_DECL_NOEXCEPT;
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_hashBytes = 32;
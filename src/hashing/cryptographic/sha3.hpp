@@ -37,14 +37,21 @@ public:
     explicit Sha3(Bits bits = Bits::Bits256);
     virtual ~Sha3();
 
+    //! One-shot hash of a buffer into out, hashSize() / 8 bytes. No heap allocation, no exceptions, reentrant.
+    static void hash(const void *data, std::size_t length, void *out, Bits bits = Bits::Bits256) Q_DECL_NOEXCEPT;
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     /// 1600 bits, stored as 25x64 bit, BlockSize is no more than 1152 bits (Keccak224)
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef DIGEST_HPP
+#define DIGEST_HPP
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+
+namespace qkeeg { namespace hashing {
+
+//! Fixed-size, stack allocated hash result.
+template<std::size_t N>
+class Digest
+{
+public:
+    using value_type = quint8;
+    using iterator = typename std::array<quint8, N>::iterator;
+    using const_iterator = typename std::array<quint8, N>::const_iterator;
+
+    //! Zero filled digest.
+    Digest() Q_DECL_NOEXCEPT { m_data.fill(0); }
+    //! Copy N bytes from a raw buffer.
+    explicit Digest(const void *data) Q_DECL_NOEXCEPT
+    {
+        std::memcpy(m_data.data(), data, N);
+    }
+
+    //! Size of the digest in bytes.
+    static constexpr std::size_t size() Q_DECL_NOEXCEPT { return N; }
+
+    quint8 *data() Q_DECL_NOEXCEPT { return m_data.data(); }
+    const quint8 *data() const Q_DECL_NOEXCEPT { return m_data.data(); }
+
+    iterator begin() Q_DECL_NOEXCEPT { return m_data.begin(); }
+    iterator end() Q_DECL_NOEXCEPT { return m_data.end(); }
+    const_iterator begin() const Q_DECL_NOEXCEPT { return m_data.begin(); }
+    const_iterator end() const Q_DECL_NOEXCEPT { return m_data.end(); }
+
+    quint8 &operator [](std::size_t index) Q_DECL_NOEXCEPT { return m_data[index]; }
+    const quint8 &operator [](std::size_t index) const Q_DECL_NOEXCEPT { return m_data[index]; }
+
+    //! Copy the digest into a byte array.
+    QByteArray toByteArray() const
+    {
+        return QByteArray(reinterpret_cast<const char*>(m_data.data()), static_cast<int>(N));
+    }
+
+    //! Get the digest as a hex string.
+    QString toHex(bool useUpperCase = true) const
+    {
+        QByteArray temp = toByteArray().toHex();
+        return QString(useUpperCase ? temp.toUpper() : temp);
+    }
+
+    bool operator ==(const Digest &other) const Q_DECL_NOEXCEPT { return m_data == other.m_data; }
+    bool operator !=(const Digest &other) const Q_DECL_NOEXCEPT { return m_data != other.m_data; }
+    bool operator <(const Digest &other) const Q_DECL_NOEXCEPT { return m_data < other.m_data; }
+
+private:
+    std::array<quint8, N> m_data;
+};
+
+using Digest32  = Digest<4>;
+using Digest64  = Digest<8>;
+using Digest128 = Digest<16>;
+using Digest160 = Digest<20>;
+using Digest224 = Digest<28>;
+using Digest256 = Digest<32>;
+using Digest384 = Digest<48>;
+using Digest512 = Digest<64>;
+
+template<std::size_t N>
+inline uint qHash(const Digest<N> &key, uint seed = 0) Q_DECL_NOEXCEPT
+{
+    return qHashBits(key.data(), N, seed);
+}
+
+} // namespace hashing
+} // namespace qkeeg
+
+namespace std {
+
+template<std::size_t N>
+struct hash<qkeeg::hashing::Digest<N>>
+{
+    std::size_t operator ()(const qkeeg::hashing::Digest<N> &key) const Q_DECL_NOEXCEPT
+    {
+        // Digests are already well mixed, so fold the leading bytes.
+        std::size_t result = 0;
+        std::memcpy(&result, key.data(), std::min(sizeof(result), N));
+        return result;
+    }
+};
+
+} // namespace std
+
+#endif // DIGEST_HPP
@@ -0,0 +1,470 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "digestcache.hpp"
+#include "noncryptographic/fnv1ahash32.hpp"
+#include "noncryptographic/fnv1ahash64.hpp"
+#include "../common/endian.hpp"
+#include "../io/binarywriter.hpp"
+#include <QBuffer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <QDateTime>
+#endif
+
+namespace qkeeg { namespace hashing {
+
+namespace {
+
+// Cache file layout, all little endian:
+//   header: magic, version, record size, reserved (4 x quint32)
+//   record: device, inode, size, mtime ns (4 x 64 bit), algorithm (quint32),
+//           digest length (quint8), 3 reserved bytes, digest (MaxDigestSize bytes)
+const quint32 Magic      = 0x4344'4B51; // "QKDC"
+const quint32 Version    = 1;
+const qint64  HeaderSize = 16;
+const qint64  RecordSize = 40 + DigestCache::MaxDigestSize;
+
+const int DeviceOffset       = 0;
+const int InodeOffset        = 8;
+const int SizeOffset         = 16;
+const int MtimeOffset        = 24;
+const int AlgorithmOffset    = 32;
+const int DigestLengthOffset = 36;
+const int DigestOffset       = 40;
+
+//! Message hashed by algorithmId().
+const char Probe[] = "qkeeg digest cache";
+
+//! Records read or written at once while compacting.
+const qint64 CompactBatch = 4096;
+
+quint64 mix(quint64 value)
+{
+    value ^= value >> 33;
+    value *= UINT64_C(0xff51afd7ed558ccd);
+    value ^= value >> 33;
+    value *= UINT64_C(0xc4ceb9fe1a85ec53);
+    return value ^ (value >> 33);
+}
+
+quint32 slotOf(quint64 device, quint64 inode, qint64 size, qint64 mtimeNs, quint32 algorithm)
+{
+    quint64 hash = mix(inode ^ (device << 32) ^ algorithm);
+    hash = mix(hash ^ static_cast<quint64>(mtimeNs) ^ (static_cast<quint64>(size) << 20));
+    return static_cast<quint32>(hash);
+}
+
+//! The file a record belongs to: the same device, inode and algorithm.
+quint64 identityOf(const quint8 *record)
+{
+    quint64 hash = mix(common::bytes_to_int_little<quint64>(record + InodeOffset) ^
+                       common::bytes_to_int_little<quint32>(record + AlgorithmOffset));
+    return mix(hash ^ common::bytes_to_int_little<quint64>(record + DeviceOffset));
+}
+
+bool writeHeader(QIODevice &device)
+{
+    io::BinaryWriter writer(device, QSysInfo::LittleEndian);
+    writer.write(Magic);
+    writer.write(Version);
+    writer.write(static_cast<quint32>(RecordSize));
+    writer.write(quint32(0));
+    return writer.status() == io::BinaryWriter::Ok;
+}
+
+bool matches(const quint8 *record, const DigestCache::Key &key)
+{
+    return (common::bytes_to_int_little<quint64>(record + InodeOffset) == key.inode) &&
+           (common::bytes_to_int_little<qint64>(record + MtimeOffset) == key.mtimeNs) &&
+           (common::bytes_to_int_little<qint64>(record + SizeOffset) == key.size) &&
+           (common::bytes_to_int_little<quint64>(record + DeviceOffset) == key.device) &&
+           (common::bytes_to_int_little<quint32>(record + AlgorithmOffset) == key.algorithm);
+}
+
+} // anonymous namespace
+
+DigestCache::DigestCache(const QString &path, int maxEntries) :
+    m_file(path), m_maxEntries(maxEntries)
+{
+    if ((maxEntries <= 0) || (maxEntries > MaxEntriesLimit)) {
+        throw QString("Invalid maximum number of entries.");
+    }
+
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return;
+    }
+
+    // Anything that doesn't look like a cache of this version is thrown away.
+    bool valid = false;
+    qint64 count = 0;
+    if (m_file.size() >= HeaderSize) {
+        quint8 header[HeaderSize];
+        if (m_file.seek(0) && (m_file.read(reinterpret_cast<char*>(header), HeaderSize) == HeaderSize)) {
+            valid = (common::bytes_to_int_little<quint32>(header) == Magic) &&
+                    (common::bytes_to_int_little<quint32>(header + 4) == Version) &&
+                    (common::bytes_to_int_little<quint32>(header + 8) == RecordSize);
+        }
+        count = (m_file.size() - HeaderSize) / RecordSize;
+    }
+
+    // Nearly full: make room for this run before anything is mapped.
+    if (valid && ((count * 4) >= (static_cast<qint64>(maxEntries) * 3))) {
+        if (!compact(count) && !m_file.isOpen()) {
+            return;
+        }
+        count = (m_file.size() - HeaderSize) / RecordSize;
+    }
+    count = qMin(count, static_cast<qint64>(maxEntries));
+
+    if (!valid) {
+        count = 0;
+        m_file.resize(0);
+        m_file.seek(0);
+        if (!writeHeader(m_file) || !m_file.flush()) {
+            m_file.close();
+            return;
+        }
+    }
+
+    // Cut off a record torn by a crash, or entries beyond maxEntries.
+    if (m_file.size() != (HeaderSize + (count * RecordSize))) {
+        m_file.resize(HeaderSize + (count * RecordSize));
+    }
+
+#ifdef Q_OS_UNIX
+    // Map the full capacity up front; records appended later show up in the shared mapping
+    // without remapping, so readers never see it move.
+    m_mapSize = HeaderSize + (static_cast<qint64>(maxEntries) * RecordSize);
+    void *map = ::mmap(nullptr, static_cast<size_t>(m_mapSize), PROT_READ, MAP_SHARED, m_file.handle(), 0);
+    if (map == MAP_FAILED) {
+        m_file.close();
+        return;
+    }
+    m_map = static_cast<quint8*>(map);
+#else
+    m_records.reset(new quint8[static_cast<size_t>(maxEntries) * RecordSize]);
+    m_file.seek(HeaderSize);
+    if (m_file.read(reinterpret_cast<char*>(m_records.get()), count * RecordSize) != (count * RecordSize)) {
+        count = 0;
+    }
+#endif
+
+    // At most half full; with maxEntries <= MaxEntriesLimit that is at most 2^31 slots.
+    quint64 slotCount = 2;
+    while (slotCount < (static_cast<quint64>(maxEntries) * 2)) {
+        slotCount <<= 1;
+    }
+    m_index.reset(new std::atomic<quint32>[static_cast<size_t>(slotCount)]());
+    m_indexMask = static_cast<quint32>(slotCount - 1);
+
+    for (quint32 i = 0; i < count; ++i) {
+        publish(i);
+    }
+    m_count.store(static_cast<int>(count), std::memory_order_release);
+}
+
+DigestCache::~DigestCache()
+{
+    flush();
+#ifdef Q_OS_UNIX
+    if (m_map != nullptr) {
+        ::munmap(m_map, static_cast<size_t>(m_mapSize));
+    }
+#endif
+}
+
+bool DigestCache::isOpen() const
+{
+    return m_index != nullptr;
+}
+
+int DigestCache::count() const
+{
+    return m_count.load(std::memory_order_acquire);
+}
+
+int DigestCache::maxEntries() const
+{
+    return m_maxEntries;
+}
+
+int DigestCache::batchSize() const
+{
+    return m_batchSize;
+}
+
+void DigestCache::setBatchSize(int size)
+{
+    m_batchSize = qMax(size, 1);
+}
+
+quint32 DigestCache::algorithmId(const HashAlgorithm &algorithm)
+{
+    std::unique_ptr<HashAlgorithm> probe = algorithm.clone();
+    probe->setProgressCallback(nullptr);
+
+    QByteArray identity = probe->name().toUtf8();
+    identity.append(probe->computeHash(Probe, static_cast<qint64>(sizeof(Probe) - 1)));
+    return noncryptographic::Fnv1aHash32::hash(identity.constData(), static_cast<std::size_t>(identity.size()));
+}
+
+DigestCache::Key DigestCache::makeKey(const QString &path, quint32 algorithm)
+{
+    Key key;
+    key.algorithm = algorithm;
+
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if ((::stat(QFile::encodeName(path).constData(), &info) != 0) || !S_ISREG(info.st_mode)) {
+        return key;
+    }
+
+    key.device = static_cast<quint64>(info.st_dev);
+    key.inode  = static_cast<quint64>(info.st_ino);
+    key.size   = static_cast<qint64>(info.st_size);
+#if defined(Q_OS_DARWIN)
+    key.mtimeNs = (static_cast<qint64>(info.st_mtimespec.tv_sec) * 1000000000) + info.st_mtimespec.tv_nsec;
+#else
+    key.mtimeNs = (static_cast<qint64>(info.st_mtim.tv_sec) * 1000000000) + info.st_mtim.tv_nsec;
+#endif
+#else
+    // No inode here, the path stands in for it.
+    const QFileInfo info(path);
+    if (!info.isFile()) {
+        return key;
+    }
+
+    const QByteArray absolutePath = info.absoluteFilePath().toUtf8();
+    key.inode   = noncryptographic::Fnv1aHash64::hash(absolutePath.constData(), static_cast<std::size_t>(absolutePath.size()));
+    key.size    = info.size();
+    key.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+#endif
+
+    return key;
+}
+
+QByteArray DigestCache::find(const Key &key) const
+{
+    if (!key.isValid() || !m_index) {
+        return QByteArray();
+    }
+
+    quint32 slot = slotOf(key.device, key.inode, key.size, key.mtimeNs, key.algorithm) & m_indexMask;
+    for (;;) {
+        const quint32 entry = m_index[slot].load(std::memory_order_acquire);
+        if (entry == 0) {
+            return QByteArray();
+        }
+
+        const quint8 *candidate = record(entry - 1);
+        if (matches(candidate, key)) {
+            return QByteArray(reinterpret_cast<const char*>(candidate + DigestOffset), candidate[DigestLengthOffset]);
+        }
+
+        slot = (slot + 1) & m_indexMask;
+    }
+}
+
+void DigestCache::insert(const Key &key, const QByteArray &digest)
+{
+    if (!key.isValid() || digest.isEmpty() || (digest.size() > MaxDigestSize) || !m_index) {
+        return;
+    }
+
+    QMutexLocker locker(&m_writeMutex);
+    writeRecord(key, digest);
+    if (m_pendingCount >= m_batchSize) {
+        locker.unlock();
+        flush();
+    }
+}
+
+void DigestCache::flush()
+{
+    QMutexLocker locker(&m_writeMutex);
+    if ((m_pendingCount == 0) || !m_index) {
+        return;
+    }
+
+    // Whatever doesn't fit any more is dropped, the next open compacts the file.
+    const int first = count();
+    const int added = qMin(m_pendingCount, m_maxEntries - first);
+    m_pending.truncate(static_cast<int>(added * RecordSize));
+    m_pendingCount = 0;
+    if (added <= 0) {
+        m_pending.clear();
+        return;
+    }
+
+    const qint64 end = HeaderSize + (first * RecordSize);
+    if (!m_file.seek(end) || (m_file.write(m_pending) != m_pending.size()) || !m_file.flush()) {
+        // Leave the file as it was, a half written batch would be read back as garbage.
+        m_file.resize(end);
+        m_pending.clear();
+        return;
+    }
+
+#ifndef Q_OS_UNIX
+    std::memcpy(m_records.get() + (first * RecordSize), m_pending.constData(), static_cast<size_t>(m_pending.size()));
+#endif
+    m_pending.clear();
+
+    for (int i = 0; i < added; ++i) {
+        publish(static_cast<quint32>(first + i));
+    }
+    m_count.store(first + added, std::memory_order_release);
+}
+
+QByteArray DigestCache::computeFileHash(const QString &path, HashAlgorithm &algorithm)
+{
+    const quint32 id = algorithmId(algorithm);
+    const Key before = makeKey(path, id);
+    QByteArray digest = find(before);
+    if (!digest.isEmpty()) {
+        return digest;
+    }
+
+    digest = algorithm.computeFileHash(path);
+
+    // A file written to while it was hashed gets a new mtime, its digest is of no use later.
+    if (!digest.isEmpty() && before.isValid()) {
+        const Key after = makeKey(path, id);
+        if ((after.device == before.device) && (after.inode == before.inode) &&
+            (after.size == before.size) && (after.mtimeNs == before.mtimeNs)) {
+            insert(before, digest);
+        }
+    }
+
+    return digest;
+}
+
+bool DigestCache::compact(qint64 recordCount)
+{
+    // Only the last record of a file can still match it, the ones before were written for
+    // versions that have been replaced since.
+    std::unordered_map<quint64, qint64> latest;
+    std::vector<quint8> batch(static_cast<size_t>(CompactBatch * RecordSize));
+    if (!m_file.seek(HeaderSize)) {
+        return false;
+    }
+    for (qint64 first = 0; first < recordCount; first += CompactBatch) {
+        const qint64 length = qMin(CompactBatch, recordCount - first) * RecordSize;
+        if (m_file.read(reinterpret_cast<char*>(batch.data()), length) != length) {
+            return false;
+        }
+        for (qint64 i = 0; (i * RecordSize) < length; ++i) {
+            latest[identityOf(batch.data() + (i * RecordSize))] = first + i;
+        }
+    }
+
+    // Of those, keep the newest half of the capacity. Deleted files can't be told apart from
+    // files not seen for a while, so they age out this way.
+    const qint64 live = static_cast<qint64>(latest.size());
+    const qint64 skip = live - qMin(live, qMax(static_cast<qint64>(m_maxEntries) / 2, Q_INT64_C(1)));
+
+    // Written next to the cache and renamed over it, so a crash leaves either the old or the new file.
+    QSaveFile compacted(m_file.fileName());
+    if (!compacted.open(QIODevice::WriteOnly) || !writeHeader(compacted) || !m_file.seek(HeaderSize)) {
+        return false;
+    }
+
+    qint64 seen = 0;
+    for (qint64 first = 0; first < recordCount; first += CompactBatch) {
+        const qint64 length = qMin(CompactBatch, recordCount - first) * RecordSize;
+        if (m_file.read(reinterpret_cast<char*>(batch.data()), length) != length) {
+            compacted.cancelWriting();
+            return false;
+        }
+
+        qint64 kept = 0;
+        for (qint64 i = 0; (i * RecordSize) < length; ++i) {
+            const quint8 *entry = batch.data() + (i * RecordSize);
+            if ((latest.at(identityOf(entry)) == (first + i)) && (seen++ >= skip)) {
+                std::memmove(batch.data() + (kept++ * RecordSize), entry, static_cast<size_t>(RecordSize));
+            }
+        }
+        if (compacted.write(reinterpret_cast<const char*>(batch.data()), kept * RecordSize) != (kept * RecordSize)) {
+            compacted.cancelWriting();
+            return false;
+        }
+    }
+
+    // Closed first, some platforms can't replace a file that is open.
+    m_file.close();
+    const bool committed = compacted.commit();
+    return m_file.open(QIODevice::ReadWrite) && committed;
+}
+
+const quint8 *DigestCache::record(quint32 index) const
+{
+#ifdef Q_OS_UNIX
+    return m_map + HeaderSize + (static_cast<qint64>(index) * RecordSize);
+#else
+    return m_records.get() + (static_cast<qint64>(index) * RecordSize);
+#endif
+}
+
+void DigestCache::publish(quint32 index)
+{
+    const quint8 *entry = record(index);
+    quint32 slot = slotOf(common::bytes_to_int_little<quint64>(entry + DeviceOffset),
+                          common::bytes_to_int_little<quint64>(entry + InodeOffset),
+                          common::bytes_to_int_little<qint64>(entry + SizeOffset),
+                          common::bytes_to_int_little<qint64>(entry + MtimeOffset),
+                          common::bytes_to_int_little<quint32>(entry + AlgorithmOffset)) & m_indexMask;
+
+    // Only one writer at a time, but readers may be probing: the release store makes the record
+    // visible before its slot is.
+    while (m_index[slot].load(std::memory_order_relaxed) != 0) {
+        slot = (slot + 1) & m_indexMask;
+    }
+    m_index[slot].store(index + 1, std::memory_order_release);
+}
+
+void DigestCache::writeRecord(const Key &key, const QByteArray &digest)
+{
+    QBuffer buffer(&m_pending);
+    buffer.open(QIODevice::WriteOnly | QIODevice::Append);
+
+    io::BinaryWriter writer(buffer, QSysInfo::LittleEndian);
+    writer.write(key.device);
+    writer.write(key.inode);
+    writer.write(key.size);
+    writer.write(key.mtimeNs);
+    writer.write(key.algorithm);
+    writer.write(static_cast<quint8>(digest.size()));
+    writer.write(QByteArray(3, '\0'));
+    writer.write(digest);
+    writer.write(QByteArray(MaxDigestSize - digest.size(), '\0'));
+    ++m_pendingCount;
+}
+
+} // namespace hashing
+} // namespace qkeeg
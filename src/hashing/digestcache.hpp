@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef DIGESTCACHE_HPP
+#define DIGESTCACHE_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+namespace qkeeg { namespace hashing {
+
+//! Remembers file digests across runs in a memory mapped file, so unchanged files don't have
+//! to be read again. An entry is keyed by device, inode, size, modification time in ns and
+//! algorithm; once a file changes its key no longer matches and the old entry is never returned.
+//! Lookups don't take a lock and can run on any number of threads. New entries are appended in
+//! batches and can be found once flushed. Only one process should write a cache file at a time.
+//! Opening a cache that is at least three quarters full compacts it: entries replaced by a newer
+//! one for the same file are dropped, and of the rest only the newest maxEntries / 2 are kept.
+//! Once full, new entries are dropped until the next open.
+class DigestCache
+{
+    Q_GADGET
+
+public:
+    //! One version of one file, for one algorithm. size is -1 if the file couldn't be stat'ed.
+    struct Key
+    {
+        quint64 device    = 0;
+        quint64 inode     = 0;
+        qint64  size      = -1;
+        qint64  mtimeNs   = 0;
+        quint32 algorithm = 0;
+
+        bool isValid() const { return size >= 0; }
+    };
+
+    static const int DefaultMaxEntries = 1 << 20;
+    //! Largest maxEntries accepted, keeps the index size within 32 bits.
+    static const int MaxEntriesLimit   = 1 << 30;
+    static const int DefaultBatchSize  = 256;
+    //! Longer digests are not cached.
+    static const int MaxDigestSize     = 64;
+
+    //! Opens or creates the cache file at path. A file that isn't a cache is started over,
+    //! a nearly full one is compacted. Throws a QString if maxEntries isn't in
+    //! 1 to MaxEntriesLimit.
+    explicit DigestCache(const QString &path, int maxEntries = DefaultMaxEntries);
+    //! Flushes pending entries.
+    ~DigestCache();
+
+    bool isOpen() const;
+    //! Entries that can be found.
+    int count() const;
+    int maxEntries() const;
+    //! Pending entries are appended once there are this many.
+    int batchSize() const;
+    void setBatchSize(int size);
+
+    //! Identifies the algorithm by name and by its digest of a fixed message, so
+    //! differently configured instances (a crc32 polynomial) get different ids.
+    static quint32 algorithmId(const HashAlgorithm &algorithm);
+    //! Key of the file at path as it is now.
+    static Key makeKey(const QString &path, quint32 algorithm);
+
+    //! The cached digest for key, or an empty array.
+    QByteArray find(const Key &key) const;
+    //! Adds an entry, it is written and found after the next flush.
+    void insert(const Key &key, const QByteArray &digest);
+    //! Appends pending entries to the file and makes them visible to find().
+    void flush();
+
+    //! The digest of the file at path from the cache, or computed with algorithm and added
+    //! if the file didn't change while it was read.
+    QByteArray computeFileHash(const QString &path, HashAlgorithm &algorithm);
+
+private:
+    Q_DISABLE_COPY(DigestCache)
+
+    //! Rewrites the file with the live entries of its first recordCount records, see above.
+    //! False if the old file was kept or m_file couldn't be opened again.
+    bool compact(qint64 recordCount);
+    const quint8 *record(quint32 index) const;
+    void publish(quint32 index);
+    void writeRecord(const Key &key, const QByteArray &digest);
+
+    QFile   m_file;
+    int     m_maxEntries;
+    int     m_batchSize = DefaultBatchSize;
+    quint8 *m_map       = nullptr;
+    qint64  m_mapSize   = 0;
+    std::unique_ptr<quint8[]> m_records;
+
+    //! Open addressing table of record index + 1, 0 is an empty slot.
+    std::unique_ptr<std::atomic<quint32>[]> m_index;
+    quint32 m_indexMask = 0;
+    std::atomic<int> m_count{0};
+
+    QMutex     m_writeMutex;
+    QByteArray m_pending;
+    int        m_pendingCount = 0;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // DIGESTCACHE_HPP
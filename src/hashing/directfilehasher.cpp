@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "directfilehasher.hpp"
+#include "../io/bufferpool.hpp"
+#include <QFile>
+#include <QVector>
+
+#ifdef Q_OS_LINUX
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// IORING_OP_READ needs the 5.6 kernel headers. It is an enumerator, so the IORING_FEAT_RW_CUR_POS
+// flag added in the same release is tested instead. Without them only pread() is used.
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define QKEEG_HAVE_IO_URING
+#endif
+#endif
+
+namespace qkeeg { namespace hashing {
+
+#ifdef Q_OS_LINUX
+namespace {
+
+/// Closes a file descriptor when it goes out of scope.
+class FileDescriptor
+{
+public:
+    explicit FileDescriptor(int fd = -1) : m_fd(fd) { }
+    ~FileDescriptor() { if (m_fd >= 0) { ::close(m_fd); } }
+    int get() const { return m_fd; }
+
+private:
+    Q_DISABLE_COPY(FileDescriptor)
+    int m_fd;
+};
+
+static_assert((io::BufferPool::Alignment % DirectFileHasher::DirectIoAlignment) == 0,
+              "Pooled buffers must be aligned for O_DIRECT!");
+
+/// Aligned block buffers from the shared pool, handed back when they go out of scope.
+class AlignedBuffers
+{
+public:
+    AlignedBuffers(int count, qint64 size)
+    {
+        try {
+            for (int i = 0; i < count; ++i) {
+                m_buffers.push_back(HashAlgorithm::bufferPool().acquire(size));
+            }
+        }
+        catch (const QString &) {
+            m_buffers.clear();
+        }
+    }
+    bool isValid() const { return !m_buffers.empty(); }
+    char *at(int index) const { return m_buffers[static_cast<std::size_t>(index)].data(); }
+
+private:
+    Q_DISABLE_COPY(AlignedBuffers)
+    std::vector<io::BufferPool::Buffer> m_buffers;
+};
+
+#ifdef QKEEG_HAVE_IO_URING
+qint64 alignUp(qint64 value, qint64 alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+/// Minimal io_uring on the raw system calls, only what reading a file needs.
+class IoUring
+{
+public:
+    IoUring() { }
+    ~IoUring()
+    {
+        if (m_sqes != MAP_FAILED) {
+            ::munmap(m_sqes, m_sqesSize);
+        }
+        if ((m_cqRing != MAP_FAILED) && (m_cqRing != m_sqRing)) {
+            ::munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing != MAP_FAILED) {
+            ::munmap(m_sqRing, m_sqRingSize);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    bool setup(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0) {
+            return false;
+        }
+
+        m_sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+        m_cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            m_sqRingSize = m_cqRingSize = qMax(m_sqRingSize, m_cqRingSize);
+        }
+
+        m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED) {
+            return false;
+        }
+
+        m_cqRing = singleMap ? m_sqRing
+                             : ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            return false;
+        }
+
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sqes == MAP_FAILED) {
+            return false;
+        }
+
+        char *sq = static_cast<char*>(m_sqRing);
+        char *cq = static_cast<char*>(m_cqRing);
+        m_sqTail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_cqHead  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /// Queue a read and hand it to the kernel.
+    bool submitRead(int fd, void *buffer, unsigned length, quint64 offset, quint64 userData)
+    {
+        const unsigned tail  = *m_sqTail;
+        const unsigned index = tail & *m_sqMask;
+        io_uring_sqe *sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = fd;
+        sqe->addr      = reinterpret_cast<quintptr>(buffer);
+        sqe->len       = length;
+        sqe->off       = offset;
+        sqe->user_data = userData;
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        return enter(1, 0) >= 0;
+    }
+
+    /// Block until at least one completion is available.
+    bool waitForCompletion()
+    {
+        return enter(0, 1) >= 0;
+    }
+
+    /// Pop one completion without blocking.
+    bool reap(quint64 &userData, int &result)
+    {
+        const unsigned head = *m_cqHead;
+        if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+
+        const io_uring_cqe &cqe = m_cqes[head & *m_cqMask];
+        userData = cqe.user_data;
+        result   = cqe.res;
+        __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    Q_DISABLE_COPY(IoUring)
+
+    int enter(unsigned toSubmit, unsigned minComplete)
+    {
+        int result;
+        do {
+            result = static_cast<int>(::syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete,
+                                                (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+        } while ((result < 0) && (errno == EINTR));
+
+        return result;
+    }
+
+    int m_fd = -1;
+    void *m_sqRing = MAP_FAILED;
+    void *m_cqRing = MAP_FAILED;
+    void *m_sqes   = MAP_FAILED;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize   = 0;
+    unsigned *m_sqTail  = nullptr;
+    unsigned *m_sqMask  = nullptr;
+    unsigned *m_sqArray = nullptr;
+    unsigned *m_cqHead  = nullptr;
+    unsigned *m_cqTail  = nullptr;
+    unsigned *m_cqMask  = nullptr;
+    io_uring_cqe *m_cqes = nullptr;
+};
+#endif // QKEEG_HAVE_IO_URING
+
+} // anonymous namespace
+#endif // Q_OS_LINUX
+
+DirectFileHasher::DirectFileHasher(HashAlgorithm &algorithm) :
+    m_algorithm(algorithm)
+{
+
+}
+
+QByteArray DirectFileHasher::computeHash(const QString &path)
+{
+    m_algorithm.requireIncremental();
+
+    m_lastBackend = Backend::None;
+    m_lastUsedDirectIo = false;
+
+#ifdef Q_OS_LINUX
+    const QByteArray nativePath = QFile::encodeName(path);
+    bool direct = true;
+    int fd = ::open(nativePath.constData(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    if (fd < 0) {
+        // tmpfs and some network file systems reject O_DIRECT.
+        direct = false;
+        fd = ::open(nativePath.constData(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return QByteArray();
+    }
+
+    FileDescriptor file(fd);
+    struct stat info;
+    if ((::fstat(fd, &info) != 0) || !S_ISREG(info.st_mode)) {
+        return QByteArray();
+    }
+
+    const qint64 fileSize = static_cast<qint64>(info.st_size);
+    m_algorithm.reset();
+
+    qint64 hashed = 0;
+    if (!hashWithIoUring(fd, direct, fileSize, hashed)) {
+        m_algorithm.reset();
+        return QByteArray();
+    }
+
+    if (hashed < fileSize) {
+        // No io_uring, or it gave up part way. Carry on from the last hashed block.
+        FileDescriptor buffered(direct ? ::open(nativePath.constData(), O_RDONLY | O_CLOEXEC) : -1);
+        const int readFd = direct ? buffered.get() : fd;
+        if ((readFd < 0) || !hashWithPread(readFd, fileSize, hashed)) {
+            m_algorithm.reset();
+            return QByteArray();
+        }
+    }
+
+    return m_algorithm.finalize();
+#else
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    m_lastBackend = Backend::QtFile;
+    return m_algorithm.computeHash(file);
+#endif
+}
+
+int DirectFileHasher::queueDepth() const
+{
+    return m_queueDepth;
+}
+
+void DirectFileHasher::setQueueDepth(int depth)
+{
+    m_queueDepth = qBound(1, depth, 256);
+}
+
+qint64 DirectFileHasher::blockSize() const
+{
+    return (m_blockSize > 0) ? m_blockSize : HashAlgorithm::bufferPool().bufferSize();
+}
+
+void DirectFileHasher::setBlockSize(qint64 size)
+{
+    m_blockSize = qMax(DirectIoAlignment, ((size + DirectIoAlignment - 1) / DirectIoAlignment) * DirectIoAlignment);
+}
+
+DirectFileHasher::Backend DirectFileHasher::lastBackend() const
+{
+    return m_lastBackend;
+}
+
+bool DirectFileHasher::lastUsedDirectIo() const
+{
+    return m_lastUsedDirectIo;
+}
+
+bool DirectFileHasher::hashWithIoUring(int fd, bool direct, qint64 fileSize, qint64 &hashed)
+{
+#ifdef QKEEG_HAVE_IO_URING
+    hashed = 0;
+    if (fileSize == 0) {
+        return true;
+    }
+
+    const qint64 blockSize = this->blockSize();
+    IoUring ring;
+    const int depth = static_cast<int>(qMin(static_cast<qint64>(m_queueDepth), (fileSize + blockSize - 1) / blockSize));
+    if (!ring.setup(static_cast<unsigned>(depth))) {
+        // Not available, e.g. an old kernel or blocked by a seccomp policy; the caller uses pread().
+        return true;
+    }
+
+    AlignedBuffers buffers(depth, blockSize);
+    if (!buffers.isValid()) {
+        return false;
+    }
+
+    // Block n always goes to slot n % depth, so blocks are hashed in file order.
+    QVector<qint64> offsets(depth, 0);
+    QVector<int> results(depth, 0);
+    QVector<bool> completed(depth, false);
+    int inFlight = 0;
+    qint64 nextOffset = 0;
+    bool failed = false;
+
+    auto submit = [&](int slot) {
+        const qint64 want = qMin(blockSize, fileSize - nextOffset);
+        const qint64 length = direct ? alignUp(want, DirectIoAlignment) : want;
+        offsets[slot] = nextOffset;
+        completed[slot] = false;
+        if (!ring.submitRead(fd, buffers.at(slot), static_cast<unsigned>(length), static_cast<quint64>(nextOffset),
+                             static_cast<quint64>(slot))) {
+            return false;
+        }
+
+        nextOffset += want;
+        ++inFlight;
+        return true;
+    };
+
+    for (int slot = 0; (slot < depth) && (nextOffset < fileSize); ++slot) {
+        if (!submit(slot)) {
+            failed = true;
+            break;
+        }
+    }
+
+    m_lastBackend = Backend::IoUring;
+    m_lastUsedDirectIo = direct;
+
+    for (int slot = 0; !failed && (hashed < fileSize); slot = (slot + 1) % depth) {
+        while (!completed[slot]) {
+            if (!ring.waitForCompletion()) {
+                failed = true;
+                break;
+            }
+
+            quint64 userData;
+            int result;
+            while (ring.reap(userData, result)) {
+                completed[static_cast<int>(userData)] = true;
+                results[static_cast<int>(userData)] = result;
+                --inFlight;
+            }
+        }
+
+        const qint64 expected = qMin(blockSize, fileSize - offsets[slot]);
+        if (failed || (results[slot] < expected)) {
+            // Error or short read, let the pread() path take over from here.
+            failed = true;
+            break;
+        }
+
+        m_algorithm.update(buffers.at(slot), expected);
+        hashed += expected;
+
+        if ((nextOffset < fileSize) && !submit(slot)) {
+            failed = true;
+        }
+    }
+
+    // The kernel may still write into the buffers, wait for everything before they are freed.
+    while (inFlight > 0) {
+        quint64 userData;
+        int result;
+        if (ring.reap(userData, result)) {
+            --inFlight;
+        }
+        else if (!ring.waitForCompletion()) {
+            return false;
+        }
+    }
+
+    return true;
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(direct);
+    Q_UNUSED(fileSize);
+    hashed = 0;
+    return true;
+#endif
+}
+
+bool DirectFileHasher::hashWithPread(int fd, qint64 fileSize, qint64 offset)
+{
+#ifdef Q_OS_LINUX
+    if (m_lastBackend == Backend::None) {
+        m_lastBackend = Backend::PosixRead;
+    }
+
+    const qint64 blockSize = this->blockSize();
+    AlignedBuffers buffer(1, blockSize);
+    if (!buffer.isValid()) {
+        return false;
+    }
+
+    ::posix_fadvise(fd, offset, fileSize - offset, POSIX_FADV_SEQUENTIAL);
+    while (offset < fileSize) {
+        const qint64 want = qMin(blockSize, fileSize - offset);
+        const ssize_t numBytesRead = ::pread(fd, buffer.at(0), static_cast<size_t>(want), offset);
+        if (numBytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (numBytesRead == 0) {
+            // The file shrank while it was hashed.
+            return false;
+        }
+
+        m_algorithm.update(buffer.at(0), numBytesRead);
+        // Drop what was just read, so hashing a big file doesn't push out everyone else's pages.
+        ::posix_fadvise(fd, offset, numBytesRead, POSIX_FADV_DONTNEED);
+        offset += numBytesRead;
+    }
+
+    return true;
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(fileSize);
+    Q_UNUSED(offset);
+    return false;
+#endif
+}
+
+} // namespace hashing
+} // namespace qkeeg
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef DIRECTFILEHASHER_HPP
+#define DIRECTFILEHASHER_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QString>
+
+namespace qkeeg { namespace hashing {
+
+//! Hashes large files by path without going through, or filling up, the page cache.
+//! On Linux the file is opened with O_DIRECT where the file system allows it and several aligned
+//! reads are kept in flight through io_uring, each block is hashed as soon as it and all blocks
+//! before it have arrived. Without io_uring, at runtime or in the kernel headers it was built
+//! against (5.6 or later needed), it falls back to pread() with posix_fadvise() hints,
+//! dropping the pages it read. Other platforms use HashAlgorithm::computeHash(QIODevice&).
+class DirectFileHasher
+{
+    Q_GADGET
+
+public:
+    enum class Backend { None, IoUring, PosixRead, QtFile };
+
+    explicit DirectFileHasher(HashAlgorithm &algorithm);
+
+    //! Hash the file at path. Returns an empty array if it can't be opened or read. Throws a
+    //! QString if the algorithm isn't isIncremental().
+    QByteArray computeHash(const QString &path);
+
+    //! Number of reads kept in flight.
+    int queueDepth() const;
+    void setQueueDepth(int depth);
+    //! Size of each read, rounded up to a multiple of DirectIoAlignment. Defaults to the buffer
+    //! size of HashAlgorithm::bufferPool(), so the buffers are reused across calls.
+    qint64 blockSize() const;
+    void setBlockSize(qint64 size);
+
+    //! How the last computeHash() read the file, and whether it bypassed the page cache.
+    Backend lastBackend() const;
+    bool lastUsedDirectIo() const;
+
+    //! Buffer, offset and length alignment used for O_DIRECT.
+    static const qint64 DirectIoAlignment = 4096;
+
+private:
+    bool hashWithIoUring(int fd, bool direct, qint64 fileSize, qint64 &hashed);
+    bool hashWithPread(int fd, qint64 fileSize, qint64 offset);
+
+    HashAlgorithm &m_algorithm;
+    int m_queueDepth = 8;
+    //! 0 follows the buffer pool.
+    qint64 m_blockSize = 0;
+    Backend m_lastBackend = Backend::None;
+    bool m_lastUsedDirectIo = false;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // DIRECTFILEHASHER_HPP
@@ -0,0 +1,491 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "duplicatefinder.hpp"
+#include "digestcache.hpp"
+#include "hashalgorithmregistry.hpp"
+#include "noncryptographic/xxhash64.hpp"
+#include "../common/workstealingpool.hpp"
+#include "../io/bufferpool.hpp"
+#include "../io/positionalreader.hpp"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QWaitCondition>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace qkeeg { namespace hashing {
+
+namespace {
+
+//! Chunk size of the byte by byte compare.
+const qint64 CompareBlockSize = 1024 * 1024;
+
+struct File
+{
+    QString path;
+    qint64 size;
+    quint64 device;
+    quint64 inode;
+};
+
+enum class Stage { Fingerprint, Digest, Compare };
+
+//! Files of one group going through a stage, one key each. The task that fills in the last key
+//! splits the group.
+struct Candidates
+{
+    Candidates(std::vector<const File*> &&members, const QByteArray &groupDigest) :
+        files(std::move(members)), keys(files.size()), digest(groupDigest), remaining(static_cast<int>(files.size()))
+    {
+
+    }
+
+    std::vector<const File*> files;
+    std::vector<QByteArray> keys;
+    QByteArray digest;
+    std::atomic<int> remaining;
+};
+
+} // anonymous namespace
+
+struct DuplicateFinder::Run
+{
+    Run(const DuplicateFinder &owner) :
+        prototype(*owner.m_algorithm), cache(owner.m_cache), minimumSize(owner.m_minimumSize),
+        sampleSize(owner.m_sampleSize), byteCompare(owner.m_byteCompare), pool(owner.m_threadCount)
+    {
+        if (cache != nullptr) {
+            algorithmId = DigestCache::algorithmId(prototype);
+        }
+    }
+
+    void scan(const QString &path);
+    void addFile(const QString &path, std::vector<File> &found);
+    void start(std::vector<const File*> &&members, Stage stage, const QByteArray &groupDigest = QByteArray());
+    void split(Candidates &group, Stage stage);
+    QByteArray fingerprint(const File &file);
+    QByteArray digest(const File &file);
+    void compare(const std::shared_ptr<Candidates> &group);
+    bool sameContents(const File &a, const File &b);
+    void report(const std::vector<const File*> &files, const QByteArray &digest);
+    void finishGroup();
+
+    const HashAlgorithm &prototype;
+    DigestCache *cache;
+    quint32 algorithmId = 0;
+    const qint64 minimumSize;
+    const qint64 sampleSize;
+    const bool byteCompare;
+
+    std::vector<File> files;
+
+    QMutex mutex;
+    QWaitCondition changed;
+    std::deque<Group> results;
+    //! Groups somewhere in a stage, guarded by mutex. find() is done once it is 0.
+    int activeGroups = 0;
+
+    std::atomic<qint64> fullyHashed{0};
+    std::atomic<qint64> bytesRead{0};
+    std::atomic<qint64> errors{0};
+
+    // Last, so it is stopped before the rest goes away.
+    common::WorkStealingPool pool;
+};
+
+void DuplicateFinder::Run::scan(const QString &path)
+{
+    const QFileInfoList entries = QDir(path).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot |
+                                                           QDir::Hidden | QDir::System | QDir::NoSymLinks);
+    std::vector<File> found;
+    for (const QFileInfo &entry : entries) {
+        if (entry.isDir()) {
+            const QString directory = entry.filePath();
+            pool.submit([this, directory]() { scan(directory); });
+        }
+        else if (entry.size() >= minimumSize) {
+            addFile(entry.filePath(), found);
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+void DuplicateFinder::Run::addFile(const QString &path, std::vector<File> &found)
+{
+    // Regular files only, and the inode to spot hard links.
+    const DigestCache::Key key = DigestCache::makeKey(path, 0);
+    if (!key.isValid()) {
+        ++errors;
+        return;
+    }
+
+    if (key.size >= minimumSize) {
+        found.push_back(File{ path, key.size, key.device, key.inode });
+    }
+}
+
+void DuplicateFinder::Run::start(std::vector<const File*> &&members, Stage stage, const QByteArray &groupDigest)
+{
+    {
+        QMutexLocker locker(&mutex);
+        ++activeGroups;
+    }
+
+    auto group = std::make_shared<Candidates>(std::move(members), groupDigest);
+    if (stage == Stage::Compare) {
+        pool.submit([this, group]() { compare(group); });
+        return;
+    }
+
+    for (std::size_t i = 0; i < group->files.size(); ++i) {
+        pool.submit([this, group, stage, i]() {
+            const File &file = *group->files[i];
+            group->keys[i] = (stage == Stage::Fingerprint) ? fingerprint(file) : digest(file);
+            if (--group->remaining == 0) {
+                split(*group, stage);
+            }
+        });
+    }
+}
+
+void DuplicateFinder::Run::split(Candidates &group, Stage stage)
+{
+    std::map<QByteArray, std::vector<const File*>> parts;
+    for (std::size_t i = 0; i < group.files.size(); ++i) {
+        // Unreadable files drop out.
+        if (!group.keys[i].isEmpty()) {
+            parts[group.keys[i]].push_back(group.files[i]);
+        }
+    }
+
+    for (auto &part : parts) {
+        if (part.second.size() < 2) {
+            continue;
+        }
+
+        if (stage == Stage::Fingerprint) {
+            fullyHashed += static_cast<qint64>(part.second.size());
+            start(std::move(part.second), Stage::Digest);
+        }
+        else if (byteCompare) {
+            start(std::move(part.second), Stage::Compare, part.first);
+        }
+        else {
+            report(part.second, part.first);
+        }
+    }
+
+    // Only after the parts have been started, so activeGroups can't touch 0 in between.
+    finishGroup();
+}
+
+QByteArray DuplicateFinder::Run::fingerprint(const File &file)
+{
+    io::PositionalReader reader(file.path);
+    if (!reader.isOpen() || (reader.size() != file.size)) {
+        ++errors;
+        return QByteArray();
+    }
+
+    // Head, middle and tail. Where files of one size differ tends to be at either end (headers,
+    // trailers, appended data) or all over, so three samples split most groups.
+    const qint64 offsets[3] = { 0, (file.size - sampleSize) / 2, file.size - sampleSize };
+    io::BufferPool::Buffer buffer = HashAlgorithm::bufferPool().acquire(3 * sampleSize);
+    for (int i = 0; i < 3; ++i) {
+        if (reader.read(buffer.data() + (i * sampleSize), sampleSize, offsets[i]) != sampleSize) {
+            ++errors;
+            return QByteArray();
+        }
+    }
+    bytesRead += 3 * sampleSize;
+
+    const quint64 hash = noncryptographic::XxHash64::hash(buffer.data(), static_cast<std::size_t>(3 * sampleSize),
+                                                          static_cast<quint64>(file.size));
+    return QByteArray(reinterpret_cast<const char*>(&hash), static_cast<int>(sizeof(hash)));
+}
+
+QByteArray DuplicateFinder::Run::digest(const File &file)
+{
+    QByteArray result;
+    std::unique_ptr<HashAlgorithm> algorithm = prototype.clone();
+    if (cache != nullptr) {
+        const DigestCache::Key key = DigestCache::makeKey(file.path, algorithmId);
+        result = cache->find(key);
+        if (result.isEmpty()) {
+            result = cache->computeFileHash(file.path, *algorithm);
+            bytesRead += file.size;
+        }
+    }
+    else {
+        result = algorithm->computeFileHash(file.path);
+        bytesRead += file.size;
+    }
+
+    if (result.isEmpty()) {
+        ++errors;
+    }
+
+    return result;
+}
+
+void DuplicateFinder::Run::compare(const std::shared_ptr<Candidates> &group)
+{
+    // Equal digests nearly always mean one class; anything else starts a class of its own.
+    std::vector<std::vector<const File*>> classes;
+    for (const File *file : group->files) {
+        bool placed = false;
+        for (auto &equal : classes) {
+            if (sameContents(*equal.front(), *file)) {
+                equal.push_back(file);
+                placed = true;
+                break;
+            }
+        }
+
+        if (!placed) {
+            classes.emplace_back(1, file);
+        }
+    }
+
+    for (const auto &equal : classes) {
+        if (equal.size() >= 2) {
+            report(equal, group->digest);
+        }
+    }
+
+    finishGroup();
+}
+
+bool DuplicateFinder::Run::sameContents(const File &a, const File &b)
+{
+    io::PositionalReader first(a.path);
+    io::PositionalReader second(b.path);
+    if (!first.isOpen() || !second.isOpen()) {
+        ++errors;
+        return false;
+    }
+
+    io::BufferPool::Buffer firstBuffer = HashAlgorithm::bufferPool().acquire(CompareBlockSize);
+    io::BufferPool::Buffer secondBuffer = HashAlgorithm::bufferPool().acquire(CompareBlockSize);
+    for (qint64 offset = 0; offset < a.size; offset += CompareBlockSize) {
+        const qint64 length = qMin(CompareBlockSize, a.size - offset);
+        if ((first.read(firstBuffer.data(), length, offset) != length) ||
+            (second.read(secondBuffer.data(), length, offset) != length)) {
+            ++errors;
+            return false;
+        }
+
+        bytesRead += 2 * length;
+        if (std::memcmp(firstBuffer.data(), secondBuffer.data(), static_cast<std::size_t>(length)) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void DuplicateFinder::Run::report(const std::vector<const File*> &members, const QByteArray &digest)
+{
+    Group group;
+    group.size = members.front()->size;
+    group.digest = digest;
+    for (const File *file : members) {
+        group.paths.append(file->path);
+    }
+    std::sort(group.paths.begin(), group.paths.end());
+
+    QMutexLocker locker(&mutex);
+    results.push_back(group);
+    changed.wakeAll();
+}
+
+void DuplicateFinder::Run::finishGroup()
+{
+    QMutexLocker locker(&mutex);
+    --activeGroups;
+    changed.wakeAll();
+}
+
+DuplicateFinder::DuplicateFinder(const QString &algorithm)
+{
+    m_algorithm = HashAlgorithmRegistry::instance().create(algorithm);
+    if (!m_algorithm) {
+        throw QString("Unknown hash algorithm: %1").arg(algorithm);
+    }
+    m_algorithm->requireIncremental();
+    m_algorithm->setProgressCallback(nullptr);
+}
+
+DuplicateFinder::DuplicateFinder(const HashAlgorithm &algorithm) :
+    m_algorithm(algorithm.clone())
+{
+    m_algorithm->requireIncremental();
+    m_algorithm->setProgressCallback(nullptr);
+}
+
+DuplicateFinder::~DuplicateFinder()
+{
+
+}
+
+int DuplicateFinder::threadCount() const
+{
+    return m_threadCount;
+}
+
+void DuplicateFinder::setThreadCount(int count)
+{
+    m_threadCount = qMax(count, 0);
+}
+
+qint64 DuplicateFinder::minimumSize() const
+{
+    return m_minimumSize;
+}
+
+void DuplicateFinder::setMinimumSize(qint64 size)
+{
+    m_minimumSize = qMax(size, Q_INT64_C(0));
+}
+
+qint64 DuplicateFinder::sampleSize() const
+{
+    return m_sampleSize;
+}
+
+void DuplicateFinder::setSampleSize(qint64 size)
+{
+    m_sampleSize = qMax(size, Q_INT64_C(1));
+}
+
+bool DuplicateFinder::byteCompare() const
+{
+    return m_byteCompare;
+}
+
+void DuplicateFinder::setByteCompare(bool compare)
+{
+    m_byteCompare = compare;
+}
+
+void DuplicateFinder::setDigestCache(DigestCache *cache)
+{
+    m_cache = cache;
+}
+
+DuplicateFinder::Statistics DuplicateFinder::find(const QStringList &roots, const GroupCallback &callback)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Run run(*this);
+    std::vector<File> rootFiles;
+    for (const QString &root : roots) {
+        const QFileInfo info(root);
+        if (info.isDir()) {
+            run.pool.submit([&run, root]() { run.scan(root); });
+        }
+        else if (info.size() >= m_minimumSize) {
+            run.addFile(root, rootFiles);
+        }
+    }
+    run.pool.waitForDone();
+
+    std::vector<File> &files = run.files;
+    files.insert(files.end(), rootFiles.begin(), rootFiles.end());
+
+    // Hard links, and roots that overlap, are the same file: keep one path of each.
+    std::sort(files.begin(), files.end(), [](const File &a, const File &b) {
+        return (a.device != b.device) ? (a.device < b.device) : ((a.inode != b.inode) ? (a.inode < b.inode) : (a.path < b.path));
+    });
+    files.erase(std::unique(files.begin(), files.end(), [](const File &a, const File &b) {
+        return (a.device == b.device) && (a.inode == b.inode);
+    }), files.end());
+
+    Statistics statistics;
+    statistics.files = static_cast<qint64>(files.size());
+
+    // Stage one needs no I/O at all. Files small enough to be sampled whole skip the fingerprint.
+    std::vector<const File*> bySize;
+    bySize.reserve(files.size());
+    for (const File &file : files) {
+        bySize.push_back(&file);
+    }
+    std::sort(bySize.begin(), bySize.end(), [](const File *a, const File *b) { return a->size < b->size; });
+
+    for (auto first = bySize.begin(); first != bySize.end();) {
+        auto last = std::find_if(first, bySize.end(), [first](const File *file) { return file->size != (*first)->size; });
+        if ((last - first) >= 2) {
+            statistics.sizeCandidates += (last - first);
+            const bool sampledWhole = (*first)->size <= (3 * m_sampleSize);
+            if (sampledWhole) {
+                run.fullyHashed += (last - first);
+            }
+            run.start(std::vector<const File*>(first, last), sampledWhole ? Stage::Digest : Stage::Fingerprint);
+        }
+        first = last;
+    }
+
+    // Hand groups over as they are proven.
+    for (;;) {
+        Group group;
+        {
+            QMutexLocker locker(&run.mutex);
+            while (run.results.empty() && (run.activeGroups > 0)) {
+                run.changed.wait(&run.mutex);
+            }
+
+            if (run.results.empty()) {
+                break;
+            }
+
+            group = std::move(run.results.front());
+            run.results.pop_front();
+        }
+
+        ++statistics.groups;
+        statistics.duplicates += group.paths.size() - 1;
+        statistics.wastedBytes += group.size * (group.paths.size() - 1);
+        if (callback) {
+            callback(group);
+        }
+    }
+
+    run.pool.waitForDone();
+
+    statistics.fullyHashed = run.fullyHashed;
+    statistics.bytesRead   = run.bytesRead;
+    statistics.errors      = run.errors;
+    statistics.elapsedMs   = timer.elapsed();
+    return statistics;
+}
+
+} // namespace hashing
+} // namespace qkeeg
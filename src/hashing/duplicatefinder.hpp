@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef DUPLICATEFINDER_HPP
+#define DUPLICATEFINDER_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <memory>
+
+namespace qkeeg { namespace hashing {
+
+class DigestCache;
+
+//! Finds files with the same contents below a set of directories, reading as little as it can.
+//! Files are grouped by size first; files with a unique size are never opened. Within a size, a
+//! XxHash64 over a head, a middle and a tail sample splits the group further, and only files that
+//! still collide get a full digest (sha256 by default), optionally confirmed byte by byte. Each
+//! stage runs on a work stealing pool, and a group is handed back as soon as it is proven.
+class DuplicateFinder
+{
+    Q_GADGET
+
+public:
+    //! Files with identical contents, paths sorted.
+    struct Group
+    {
+        qint64 size;
+        QByteArray digest;
+        QStringList paths;
+    };
+
+    //! Totals of one find() run.
+    struct Statistics
+    {
+        qint64 files          = 0;
+        //! Files sharing their size with another file.
+        qint64 sizeCandidates = 0;
+        //! Files that still collided after the sampled fingerprint.
+        qint64 fullyHashed    = 0;
+        qint64 groups         = 0;
+        qint64 duplicates     = 0;
+        //! Space taken by all but one file of every group.
+        qint64 wastedBytes    = 0;
+        qint64 bytesRead      = 0;
+        qint64 errors         = 0;
+        qint64 elapsedMs      = 0;
+    };
+
+    //! Called on the thread running find(), once per group, as groups are found.
+    using GroupCallback = std::function<void(const Group &)>;
+
+    static const qint64 DefaultSampleSize = 16 * 1024;
+
+    //! Full digests with algorithm from the registry. Throws a QString for unknown names and,
+    //! like the other constructor, for algorithms that aren't isIncremental().
+    explicit DuplicateFinder(const QString &algorithm = QString("sha256"));
+    explicit DuplicateFinder(const HashAlgorithm &algorithm);
+    ~DuplicateFinder();
+
+    //! Worker threads, 0 uses QThread::idealThreadCount().
+    int threadCount() const;
+    void setThreadCount(int count);
+    //! Smaller files are skipped, empty ones by default.
+    qint64 minimumSize() const;
+    void setMinimumSize(qint64 size);
+    //! Bytes read at each of the three sample points. Files up to three times this are sampled whole.
+    qint64 sampleSize() const;
+    void setSampleSize(qint64 size);
+    //! Compare the files of a group byte by byte before reporting it.
+    bool byteCompare() const;
+    void setByteCompare(bool compare);
+    //! Take full digests from, and add them to, cache. Not owned, nullptr for none.
+    void setDigestCache(DigestCache *cache);
+
+    //! Search every file below roots; a root may also be a file. Hard links to the same file
+    //! count as one file, symbolic links are not followed.
+    Statistics find(const QStringList &roots, const GroupCallback &callback);
+
+private:
+    struct Run;
+
+    std::unique_ptr<HashAlgorithm> m_algorithm;
+    DigestCache *m_cache       = nullptr;
+    int          m_threadCount = 0;
+    qint64       m_minimumSize = 1;
+    qint64       m_sampleSize  = DefaultSampleSize;
+    bool         m_byteCompare = false;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // DUPLICATEFINDER_HPP
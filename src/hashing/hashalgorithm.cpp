@@ -20,10 +20,170 @@
  * IN THE SOFTWARE.
  */
 #include "hashalgorithm.hpp"
+#include "../common/macrohelpers.hpp"
+#include "../io/binaryreader.hpp"
+#include "../io/binarywriter.hpp"
+#include "../io/bufferpool.hpp"
+#include "../io/positionalreader.hpp"
+#include "../io/readaheadreader.hpp"
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFileDevice>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cstring>
 #include <memory>
 
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 namespace qkeeg { namespace hashing {
 
+namespace {
+
+const quint32 StateMagic   = MAKE_TAG_32LE('Q','K','H','S');
+const quint16 StateVersion = UINT16_C(1);
+
+/// Stack buffer used to transcode text before it is hashed.
+const int TextChunkSize = 512;
+
+/// Size of the block of zeros hashZeros() feeds from, small enough to stay in cache.
+const qint64 ZeroBlockSize = Q_INT64_C(65536);
+
+/// Files smaller than this are read, mapping them costs more than the copy saves.
+const qint64 MinMappedFileSize = Q_INT64_C(262144);
+/// How far ahead of the hashing position the kernel is asked to page in a mapped file.
+const qint64 MappedLookAhead = Q_INT64_C(8388608);
+
+/// Mapping offsets are rounded down to this.
+qint64 mappingGranularity()
+{
+#ifdef Q_OS_UNIX
+    static const qint64 pageSize = static_cast<qint64>(::sysconf(_SC_PAGESIZE));
+    return (pageSize > 0) ? pageSize : Q_INT64_C(4096);
+#else
+    return Q_INT64_C(65536);
+#endif
+}
+
+/// Pipes being hashed are grown to this, fewer and larger reads.
+const int PipeBufferSize = 1048576;
+
+enum class MappedAccess { Sequential, WillNeed };
+
+/// Paging hint for part of a mapping. A no-op where madvise() isn't available.
+void adviseMapped(const uchar *address, qint64 length, MappedAccess access)
+{
+#ifdef Q_OS_UNIX
+    const quintptr pageMask = static_cast<quintptr>(mappingGranularity() - 1);
+    const quintptr begin = reinterpret_cast<quintptr>(address) & ~pageMask;
+    const quintptr end   = reinterpret_cast<quintptr>(address) + static_cast<quintptr>(length);
+    ::madvise(reinterpret_cast<void*>(begin), end - begin,
+              (access == MappedAccess::Sequential) ? MADV_SEQUENTIAL : MADV_WILLNEED);
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(length);
+    Q_UNUSED(access);
+#endif
+}
+
+/// Turn length -1 into the rest of the file and check the range lies within it.
+qint64 resolveRangeLength(qint64 size, qint64 offset, qint64 length)
+{
+    if (offset < 0) {
+        throw QString("Invalid offset.");
+    }
+    if (length < -1) {
+        throw QString("Invalid length.");
+    }
+    if (offset > size) {
+        throw QString("Invalid offset and length specified.");
+    }
+    if (length == -1) {
+        return size - offset;
+    }
+    if (length > (size - offset)) {
+        throw QString("Invalid offset and length specified.");
+    }
+
+    return length;
+}
+
+#ifdef Q_OS_UNIX
+/// Wait until fd has data or hit its end, at most msecs (-1 waits forever). Returns false on error
+/// or timeout. Interrupted polls keep counting from the first one.
+bool waitForDescriptor(int fd, int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (;;) {
+        const int timeout = (msecs < 0) ? -1 : static_cast<int>(qMax(Q_INT64_C(0), msecs - timer.elapsed()));
+        pollfd request = { fd, POLLIN, 0 };
+        const int ready = ::poll(&request, 1, timeout);
+        if (ready > 0) {
+            return true;
+        }
+        if ((ready == 0) || (errno != EINTR)) {
+            return false;
+        }
+    }
+}
+
+/// Hash a pipe or socket descriptor until end of file. Returns false on error or timeout.
+bool updateFromDescriptor(HashAlgorithm &algorithm, const HashAlgorithm::ProgressCallback &progress,
+                          int fd, char *buffer, qint64 bufferSize, int msecs)
+{
+#ifdef F_SETPIPE_SZ
+    struct stat info;
+    if ((::fstat(fd, &info) == 0) && S_ISFIFO(info.st_mode)) {
+        // Only ever grows the pipe; failing, e.g. above pipe-max-size, is harmless.
+        if (::fcntl(fd, F_GETPIPE_SZ) < PipeBufferSize) {
+            ::fcntl(fd, F_SETPIPE_SZ, PipeBufferSize);
+        }
+    }
+#endif
+
+    for (;;) {
+        // A blocking read() would ignore msecs, so wait for data first whenever there is a limit.
+        if ((msecs >= 0) && !waitForDescriptor(fd, msecs)) {
+            return false;
+        }
+
+        const ssize_t numBytesRead = ::read(fd, buffer, static_cast<size_t>(bufferSize));
+        if (numBytesRead > 0) {
+            algorithm.update(buffer, numBytesRead);
+            if (progress && !progress(static_cast<qint64>(algorithm.bytesHashed()))) {
+                return false;
+            }
+            continue;
+        }
+        if (numBytesRead == 0) {
+            return true;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            return false;
+        }
+
+        // Non-blocking descriptor without a limit, wait for more.
+        if ((msecs < 0) && !waitForDescriptor(fd, msecs)) {
+            return false;
+        }
+    }
+}
+#endif
+
+} // anonymous namespace
+
 HashAlgorithm::~HashAlgorithm()
 {
     if ((m_hashValue != nullptr) && !m_hashValue.isNull()) {
@@ -52,49 +212,375 @@ QByteArray HashAlgorithm::computeHash(const QByteArray &data, const qint32 &offs
         throw QString("Invalid offset and count specified.");
     }
 
-    initialize();
-    hashCore(data.data(), offset, count);
-    m_hashValue = hashFinal();
-    return m_hashValue;
+    reset();
+    update(data.constData() + offset, count);
+    return finalize();
+}
+
+QByteArray HashAlgorithm::computeHash(const void *data, qint64 length)
+{
+    reset();
+    update(data, length);
+    return finalize();
+}
+
+QByteArray HashAlgorithm::computeHashPipelined(QIODevice &instream, int bufferCount)
+{
+    requireIncremental();
+
+    if (!instream.isReadable()) {
+        return QByteArray();
+    }
+
+    instream.seek(0);
+    reset();
+
+    io::ReadAheadReader reader(instream, instream.size(), bufferPool(), bufferCount);
+    qint64 length = 0;
+    while (const char *block = reader.next(length)) {
+        update(block, length);
+        reader.release();
+        if (!reportProgress()) {
+            reset();
+            return QByteArray();
+        }
+    }
+
+    if (reader.hasError()) {
+        reset();
+        return QByteArray();
+    }
+
+    return finalize();
+}
+
+QByteArray HashAlgorithm::computeHashStream(QIODevice &instream, int msecs)
+{
+    requireIncremental();
+
+    if (!instream.isReadable()) {
+        return QByteArray();
+    }
+
+    reset();
+    if (!updateFromStream(instream, msecs)) {
+        reset();
+        return QByteArray();
+    }
+
+    return finalize();
+}
+
+QByteArray HashAlgorithm::computeHash(QIODevice &instream, qint64 offset, qint64 length)
+{
+    if (!instream.isReadable()) {
+        return QByteArray();
+    }
+
+    io::PositionalReader reader(instream);
+    return computeHash(reader, offset, length);
+}
+
+QByteArray HashAlgorithm::computeFileHash(const QString &path, qint64 offset, qint64 length)
+{
+    io::PositionalReader reader(path);
+    return computeHash(reader, offset, length);
+}
+
+QVector<QByteArray> HashAlgorithm::computeHashRanges(const QString &path, const QVector<ByteRange> &ranges,
+                                                     QThreadPool *pool) const
+{
+    io::PositionalReader reader(path);
+    return computeHashRanges(reader, ranges, pool);
+}
+
+QVector<QByteArray> HashAlgorithm::computeHashRanges(QIODevice &instream, const QVector<ByteRange> &ranges,
+                                                     QThreadPool *pool) const
+{
+    io::PositionalReader reader(instream);
+    return computeHashRanges(reader, ranges, pool);
+}
+
+QByteArray HashAlgorithm::computeHashSparse(QIODevice &instream)
+{
+    if (!instream.isReadable()) {
+        return QByteArray();
+    }
+
+    io::PositionalReader reader(instream);
+    return computeHashSparse(reader);
+}
+
+QByteArray HashAlgorithm::computeFileHashSparse(const QString &path)
+{
+    io::PositionalReader reader(path);
+    return computeHashSparse(reader);
+}
+
+QByteArray HashAlgorithm::computeHash(QStringView text, TextEncoding encoding)
+{
+    reset();
+    update(text, encoding);
+    return finalize();
 }
 
 QByteArray HashAlgorithm::computeHash(QIODevice &instream)
 {
+    requireIncremental();
+
     if (!instream.isReadable()) {
         return QByteArray();
     }
-    else
-    {
-        instream.seek(0);
-        qint64 bytesToRead = instream.size();
-        qint64 blockSize = (m_blockSizeBuffer > bytesToRead) ? bytesToRead : m_blockSizeBuffer;
 
-        // smart buffer array.
-        std::unique_ptr<char[]> buffer = std::make_unique<char[]>(blockSize);
-        initialize();
+    instream.seek(0);
+    reset();
+    if (!updateFromDevice(instream, instream.size())) {
+        return QByteArray();
+    }
 
-        qint64 numBytesRead = 0;
-        while (bytesToRead > 0)
-        {
-            if (bytesToRead > blockSize) {
-                numBytesRead = instream.read(buffer.get(), blockSize);
-            }
-            else {
-                numBytesRead = instream.read(buffer.get(), bytesToRead);
-            }
+    return finalize();
+}
 
-            // There was an error reading the IO device.
-            if (numBytesRead <= 0) {
-                return QByteArray();
+void HashAlgorithm::update(const void *data, qint64 length)
+{
+    if (length < 0) {
+        throw QString("Invalid length.");
+    }
+    if (length == 0) {
+        return;
+    }
+    if (data == nullptr) {
+        throw QString("Data pointer is null.");
+    }
+
+    hashCore(data, 0, length);
+    m_bytesHashed += static_cast<quint64>(length);
+}
+
+void HashAlgorithm::update(const QByteArray &data)
+{
+    update(data.constData(), data.size());
+}
+
+void HashAlgorithm::updateZeros(qint64 count)
+{
+    if (count < 0) {
+        throw QString("Invalid length.");
+    }
+    if (count == 0) {
+        return;
+    }
+
+    hashZeros(count);
+    m_bytesHashed += static_cast<quint64>(count);
+}
+
+void HashAlgorithm::update(QStringView text, TextEncoding encoding)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+
+    const ushort *units = reinterpret_cast<const ushort*>(text.utf16());
+    const qint64 length = static_cast<qint64>(text.size());
+
+    if (encoding == TextEncoding::Utf16) {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        update(units, length * static_cast<qint64>(sizeof(ushort)));
+#else
+        quint8 chunk[TextChunkSize];
+        int used = 0;
+        for (qint64 i = 0; i < length; ++i) {
+            if (used == TextChunkSize) {
+                update(chunk, used);
+                used = 0;
             }
+            chunk[used++] = static_cast<quint8>(units[i]);
+            chunk[used++] = static_cast<quint8>(units[i] >> 8);
+        }
+        update(chunk, used);
+#endif
+        return;
+    }
 
-            hashCore(reinterpret_cast<const void*>(buffer.get()), 0, numBytesRead);
-            bytesToRead -= numBytesRead;
+    // Same output as QString::toUtf8(), including '?' for unpaired surrogates. Every chunk but the
+    // last is exactly TextChunkSize bytes, so block based algorithms see the same splits each time.
+    quint8 chunk[TextChunkSize + 4];
+    int used = 0;
+    for (qint64 i = 0; i < length; ++i) {
+        if (used >= TextChunkSize) {
+            update(chunk, TextChunkSize);
+            used -= TextChunkSize;
+            std::memcpy(chunk, chunk + TextChunkSize, static_cast<std::size_t>(used));
         }
 
-        m_hashValue = hashFinal();
-        return m_hashValue;
+        const uint unit = units[i];
+        if (unit < 0x80) {
+            chunk[used++] = static_cast<quint8>(unit);
+        }
+        else if (unit < 0x800) {
+            chunk[used++] = static_cast<quint8>(0xC0 | (unit >> 6));
+            chunk[used++] = static_cast<quint8>(0x80 | (unit & 0x3F));
+        }
+        else if (QChar::isHighSurrogate(unit) && ((i + 1) < length) && QChar::isLowSurrogate(units[i + 1])) {
+            const uint ucs4 = QChar::surrogateToUcs4(static_cast<ushort>(unit), units[++i]);
+            chunk[used++] = static_cast<quint8>(0xF0 | (ucs4 >> 18));
+            chunk[used++] = static_cast<quint8>(0x80 | ((ucs4 >> 12) & 0x3F));
+            chunk[used++] = static_cast<quint8>(0x80 | ((ucs4 >> 6) & 0x3F));
+            chunk[used++] = static_cast<quint8>(0x80 | (ucs4 & 0x3F));
+        }
+        else if (QChar::isSurrogate(unit)) {
+            chunk[used++] = '?';
+        }
+        else {
+            chunk[used++] = static_cast<quint8>(0xE0 | (unit >> 12));
+            chunk[used++] = static_cast<quint8>(0x80 | ((unit >> 6) & 0x3F));
+            chunk[used++] = static_cast<quint8>(0x80 | (unit & 0x3F));
+        }
     }
+
+    update(chunk, used);
+}
+
+QByteArray HashAlgorithm::finalize()
+{
+    QByteArray result = hashFinal();
+    // initialize() clears m_hashValue, so reset first and store the result after.
+    reset();
+    m_hashValue = result;
+    return m_hashValue;
+}
+
+void HashAlgorithm::finalizeInto(void *out, std::size_t length)
+{
+    if ((out == nullptr) || (length < (hashSize() / 8))) {
+        throw QString("Output buffer is null or too small.");
+    }
+
+    // initialize() clears m_hashValue; keep the last finalize() result. Copying is only a ref count.
+    const QByteArray hashValue = m_hashValue;
+    hashFinalInto(out);
+    reset();
+    m_hashValue = hashValue;
+}
+
+quint64 HashAlgorithm::bytesHashed() const
+{
+    return m_bytesHashed;
+}
+
+QByteArray HashAlgorithm::saveState() const
+{
+    QByteArray state;
+    QBuffer buffer(&state);
+    buffer.open(QIODevice::WriteOnly);
+
+    io::BinaryWriter writer(buffer, QSysInfo::LittleEndian);
+    writer.write(StateMagic);
+    writer.write(StateVersion);
+    writer.write(name());
+    writer.write(m_bytesHashed);
+    writeState(writer);
+
+    return state;
+}
+
+bool HashAlgorithm::restoreState(const QByteArray &state)
+{
+    QByteArray data(state);
+    QBuffer buffer(&data);
+    if (!buffer.open(QIODevice::ReadOnly)) {
+        reset();
+        return false;
+    }
+
+    io::BinaryReader reader(buffer, QSysInfo::LittleEndian);
+    try
+    {
+        if ((reader.readUInt32() == StateMagic) && (reader.readUInt16() == StateVersion) &&
+            (reader.readString() == name())) {
+            quint64 bytesHashed = reader.readUInt64();
+            if (readState(reader) && (reader.status() == io::BinaryReader::Ok) && buffer.atEnd()) {
+                m_bytesHashed = bytesHashed;
+                return true;
+            }
+        }
+    }
+    catch (const QString &)
+    {
+    }
+
+    reset();
+    return false;
+}
+
+QByteArray HashAlgorithm::resumeHash(QIODevice &instream, const QByteArray &state, QByteArray *updatedState)
+{
+    requireIncremental();
+
+    if (!instream.isReadable() || !restoreState(state)) {
+        return QByteArray();
+    }
+
+    const qint64 offset = static_cast<qint64>(m_bytesHashed);
+    if ((offset > instream.size()) || !instream.seek(offset) ||
+        !updateFromDevice(instream, instream.size() - offset)) {
+        reset();
+        return QByteArray();
+    }
+
+    if (updatedState != nullptr) {
+        *updatedState = saveState();
+    }
+
+    return finalize();
+}
+
+bool HashAlgorithm::isCombinable() const
+{
+    return false;
+}
+
+bool HashAlgorithm::isIncremental() const
+{
+    return true;
+}
+
+void HashAlgorithm::requireIncremental() const
+{
+    if (!isIncremental()) {
+        throw QString("%1 can't hash a message in parts.").arg(name());
+    }
+}
+
+void HashAlgorithm::combine(const HashAlgorithm &next)
+{
+    if (!isCombinable()) {
+        throw QString("Algorithm can't be combined.");
+    }
+
+    combineCore(next, next.bytesHashed());
+    m_bytesHashed += next.bytesHashed();
+}
+
+void HashAlgorithm::hashBatch(const void * const *ptrs, const std::size_t *lens, std::size_t n, void *outDigests)
+{
+    if (n == 0) {
+        return;
+    }
+    if ((ptrs == nullptr) || (lens == nullptr) || (outDigests == nullptr)) {
+        throw QString("Batch pointer is null.");
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        if ((ptrs[i] == nullptr) && (lens[i] > 0)) {
+            throw QString("Data pointer is null.");
+        }
+    }
+
+    const QByteArray hashValue = m_hashValue;
+    hashBatchCore(ptrs, lens, n, reinterpret_cast<quint8*>(outDigests));
+    reset();
+    m_hashValue = hashValue;
 }
 
 QByteArray HashAlgorithm::hashValue() const
@@ -109,8 +595,7 @@ QString HashAlgorithm::hashValueToHex(bool useUpperCase, bool insertSpaces)
 
 QString HashAlgorithm::operator ()(const QString &text)
 {
-    QByteArray temp = text.toUtf8();
-    QByteArray hash = computeHash(temp, 0, temp.size());
+    QByteArray hash = computeHash(QStringView(text));
     return byteArrayToHex(hash);
 }
 
@@ -124,6 +609,367 @@ HashAlgorithm::HashAlgorithm()
 
 }
 
+QByteArray HashAlgorithm::hashFinal()
+{
+    QByteArray buffer(static_cast<int>(hashSize() / 8), char(0));
+    hashFinalInto(buffer.data());
+    return buffer;
+}
+
+void HashAlgorithm::hashBatchCore(const void * const *ptrs, const std::size_t *lens, std::size_t n, quint8 *outDigests)
+{
+    const std::size_t digestSize = hashSize() / 8;
+    for (std::size_t i = 0; i < n; ++i, outDigests += digestSize) {
+        initialize();
+        if (lens[i] > 0) {
+            hashCore(ptrs[i], 0, static_cast<qint64>(lens[i]));
+        }
+        hashFinalInto(outDigests);
+    }
+}
+
+void HashAlgorithm::combineCore(const HashAlgorithm &next, quint64 nextLength)
+{
+    Q_UNUSED(next);
+    Q_UNUSED(nextLength);
+    throw QString("Algorithm can't be combined.");
+}
+
+void HashAlgorithm::hashZeros(qint64 count)
+{
+    // Zero initialized and never written, so it stays in .bss and every page of it is backed
+    // by the kernel's single zero page.
+    alignas(4096) static quint8 zeros[ZeroBlockSize];
+
+    while (count > 0) {
+        const qint64 block = qMin(count, ZeroBlockSize);
+        hashCore(zeros, 0, block);
+        count -= block;
+    }
+}
+
+void HashAlgorithm::setProgressCallback(ProgressCallback callback)
+{
+    m_progressCallback = std::move(callback);
+}
+
+void HashAlgorithm::setMemoryMappingEnabled(bool enabled)
+{
+    m_memoryMapping = enabled;
+}
+
+bool HashAlgorithm::isMemoryMappingEnabled() const
+{
+    return m_memoryMapping;
+}
+
+bool HashAlgorithm::reportProgress() const
+{
+    return !m_progressCallback || m_progressCallback(static_cast<qint64>(m_bytesHashed));
+}
+
+io::BufferPool &HashAlgorithm::bufferPool()
+{
+    static io::BufferPool pool(HASH_BLOCK_BUFFER_SIZE);
+    return pool;
+}
+
+void HashAlgorithm::reset()
+{
+    initialize();
+    m_bytesHashed = 0;
+}
+
+bool HashAlgorithm::updateFromDevice(QIODevice &instream, qint64 bytesToRead)
+{
+    // If enabled, local files are hashed straight from the page cache; whatever can't be mapped is read.
+    QFileDevice *file = m_memoryMapping ? qobject_cast<QFileDevice*>(&instream) : nullptr;
+    if (file != nullptr) {
+        const qint64 mapped = updateFromMappedFile(*file, bytesToRead);
+        if (mapped < 0) {
+            return false;
+        }
+        if ((mapped > 0) && !instream.seek(instream.pos() + mapped)) {
+            return false;
+        }
+
+        bytesToRead -= mapped;
+    }
+
+    if (bytesToRead <= 0) {
+        return true;
+    }
+
+    io::BufferPool::Buffer buffer = bufferPool().acquire();
+    const qint64 blockSize = buffer.size();
+
+    qint64 numBytesRead = 0;
+    while (bytesToRead > 0)
+    {
+        if (bytesToRead > blockSize) {
+            numBytesRead = instream.read(buffer.data(), blockSize);
+        }
+        else {
+            numBytesRead = instream.read(buffer.data(), bytesToRead);
+        }
+
+        // There was an error reading the IO device.
+        if (numBytesRead <= 0) {
+            return false;
+        }
+
+        update(buffer.data(), numBytesRead);
+        bytesToRead -= numBytesRead;
+        if (!reportProgress()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool HashAlgorithm::updateFromStream(QIODevice &instream, int msecs)
+{
+    io::BufferPool::Buffer buffer = bufferPool().acquire();
+    const qint64 blockSize = buffer.size();
+
+#ifdef Q_OS_UNIX
+    // Pipes such as stdin: take what QIODevice already buffered, then read the descriptor
+    // directly, saving the copy through QIODevice's buffer.
+    QFileDevice *file = qobject_cast<QFileDevice*>(&instream);
+    if ((file != nullptr) && file->isSequential() && (file->handle() >= 0)) {
+        qint64 buffered;
+        while ((buffered = instream.bytesAvailable()) > 0) {
+            const qint64 numBytesRead = instream.read(buffer.data(), qMin(buffered, blockSize));
+            if (numBytesRead <= 0) {
+                return false;
+            }
+            update(buffer.data(), numBytesRead);
+            if (!reportProgress()) {
+                return false;
+            }
+        }
+
+        return updateFromDescriptor(*this, m_progressCallback, file->handle(), buffer.data(), blockSize, msecs);
+    }
+#endif
+
+    QElapsedTimer timer;
+    for (;;) {
+        const qint64 numBytesRead = instream.read(buffer.data(), blockSize);
+        if (numBytesRead > 0) {
+            update(buffer.data(), numBytesRead);
+            if (!reportProgress()) {
+                return false;
+            }
+            continue;
+        }
+        if (numBytesRead < 0) {
+            // Sockets close themselves when the peer is done.
+            return !instream.isOpen();
+        }
+        if (!instream.isSequential()) {
+            return true;
+        }
+
+        timer.start();
+        if (instream.waitForReadyRead(msecs) || (instream.bytesAvailable() > 0)) {
+            continue;
+        }
+
+        // No more data: either the stream ended or it stalled for msecs.
+        return (msecs < 0) || (timer.elapsed() < msecs);
+    }
+}
+
+bool HashAlgorithm::updateFromReader(io::PositionalReader &reader, qint64 offset, qint64 length)
+{
+    if (length <= 0) {
+        return true;
+    }
+
+    io::BufferPool::Buffer buffer = bufferPool().acquire();
+    const qint64 blockSize = buffer.size();
+
+    const qint64 end = offset + length;
+    while (offset < end) {
+        const qint64 numBytesRead = reader.read(buffer.data(), qMin(end - offset, blockSize), offset);
+
+        // Read error, or the file shrank underneath us.
+        if (numBytesRead <= 0) {
+            return false;
+        }
+
+        update(buffer.data(), numBytesRead);
+        offset += numBytesRead;
+        if (!reportProgress()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QByteArray HashAlgorithm::computeHash(io::PositionalReader &reader, qint64 offset, qint64 length)
+{
+    requireIncremental();
+
+    if (!reader.isOpen()) {
+        return QByteArray();
+    }
+
+    length = resolveRangeLength(reader.size(), offset, length);
+
+    reset();
+    if (!updateFromReader(reader, offset, length)) {
+        reset();
+        return QByteArray();
+    }
+
+    return finalize();
+}
+
+QVector<QByteArray> HashAlgorithm::computeHashRanges(io::PositionalReader &reader, const QVector<ByteRange> &ranges,
+                                                     QThreadPool *pool) const
+{
+    requireIncremental();
+
+    QVector<QByteArray> digests(ranges.size());
+    if (!reader.isOpen()) {
+        return digests;
+    }
+
+    // Check every range up front, exceptions must not escape the worker threads.
+    QVector<ByteRange> resolved;
+    resolved.reserve(ranges.size());
+    for (const ByteRange &range : ranges) {
+        resolved.append({ range.offset, resolveRangeLength(reader.size(), range.offset, range.length) });
+    }
+
+    if (pool == nullptr) {
+        pool = QThreadPool::globalInstance();
+    }
+
+    // Each task writes its own slot, so the vector is not detached while the tasks run.
+    QByteArray *results = digests.data();
+    QVector<QFuture<void>> pending;
+    pending.reserve(resolved.size());
+    for (int i = 0; i < resolved.size(); ++i) {
+        const ByteRange range = resolved.at(i);
+        pending.append(QtConcurrent::run(pool, [this, &reader, range, results, i]() {
+            std::unique_ptr<HashAlgorithm> algorithm = clone();
+            algorithm->setProgressCallback(nullptr);
+            algorithm->reset();
+            if (algorithm->updateFromReader(reader, range.offset, range.length)) {
+                results[i] = algorithm->finalize();
+            }
+        }));
+    }
+
+    for (QFuture<void> &future : pending) {
+        future.waitForFinished();
+    }
+
+    return digests;
+}
+
+QByteArray HashAlgorithm::computeHashSparse(io::PositionalReader &reader)
+{
+    requireIncremental();
+
+    if (!reader.isOpen()) {
+        return QByteArray();
+    }
+
+    reset();
+
+    const qint64 size = reader.size();
+    qint64 position = 0;
+    while (position < size) {
+        const qint64 dataStart = qBound(position, reader.nextData(position), size);
+        updateZeros(dataStart - position);
+        if (!reportProgress()) {
+            reset();
+            return QByteArray();
+        }
+        if (dataStart == size) {
+            break;
+        }
+
+        qint64 dataEnd = qMin(reader.nextHole(dataStart), size);
+        if (dataEnd <= dataStart) {
+            dataEnd = size;
+        }
+
+        if (!updateFromReader(reader, dataStart, dataEnd - dataStart)) {
+            reset();
+            return QByteArray();
+        }
+
+        position = dataEnd;
+    }
+
+    return finalize();
+}
+
+qint64 HashAlgorithm::updateFromMappedFile(QFileDevice &file, qint64 bytesToRead)
+{
+    if ((bytesToRead < MinMappedFileSize) || file.isSequential() || file.isTextModeEnabled()) {
+        return 0;
+    }
+
+    const qint64 start = file.pos();
+    if ((start < 0) || ((start + bytesToRead) > file.size())) {
+        return 0;
+    }
+
+    const qint64 granularity = mappingGranularity();
+    const qint64 blockSize = bufferPool().bufferSize();
+    qint64 hashed = 0;
+    while (hashed < bytesToRead) {
+        const qint64 position  = start + hashed;
+        const qint64 mapOffset = position - (position % granularity);
+        const qint64 skip      = position - mapOffset;
+        const qint64 length    = qMin(bytesToRead - hashed, HASH_MAP_WINDOW_SIZE - skip);
+
+        // Pages beyond the end of a file that shrank fault with SIGBUS; leave the rest to the read path,
+        // which reports the short read.
+        if ((position + length) > file.size()) {
+            break;
+        }
+
+        uchar *window = file.map(mapOffset, skip + length);
+        if (window == nullptr) {
+            break;
+        }
+
+        const uchar *current = window + skip;
+        adviseMapped(current, length, MappedAccess::Sequential);
+        adviseMapped(current, qMin(length, MappedLookAhead), MappedAccess::WillNeed);
+
+        for (qint64 done = 0; done < length; ) {
+            const qint64 block = qMin(length - done, blockSize);
+            // Keep the read-ahead a fixed distance in front of the block being hashed.
+            const qint64 ahead = done + MappedLookAhead;
+            if (ahead < length) {
+                adviseMapped(current + ahead, qMin(block, length - ahead), MappedAccess::WillNeed);
+            }
+
+            update(current + done, block);
+            done += block;
+            if (!reportProgress()) {
+                file.unmap(window);
+                return -1;
+            }
+        }
+
+        file.unmap(window);
+        hashed += length;
+    }
+
+    return hashed;
+}
+
 QString HashAlgorithm::byteArrayToHex(const QByteArray &data, bool useUpperCase, bool insertSpaces)
 {
     QByteArray temp;
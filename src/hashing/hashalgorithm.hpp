@@ -22,40 +22,163 @@
 #ifndef HASHALGORITHM_HPP
 #define HASHALGORITHM_HPP
 
+#include "digest.hpp"
 #include <QtGlobal>
 #include <QByteArray>
 #include <QIODevice>
 #include <QString>
+#include <QStringView>
+#include <QVector>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <type_traits>
 
 #ifndef HASH_BLOCK_BUFFER_SIZE
-    // Block of bytes to process per file read.
+    // Block of bytes to process per file read, the initial size of HashAlgorithm::bufferPool().
     // each cycle processes about 1 MByte (divisible by 144 => improves Keccak/SHA3 performance)
     #define HASH_BLOCK_BUFFER_SIZE Q_INT64_C(1032192) // 144 * 7 * 1024
 #endif
 
-namespace qkeeg { namespace hashing {
+#ifndef HASH_MAP_WINDOW_SIZE
+    // Largest part of a file that is memory mapped at once, bounds the address space used.
+    #if QT_POINTER_SIZE == 8
+        #define HASH_MAP_WINDOW_SIZE Q_INT64_C(1073741824) // 1 GiB
+    #else
+        #define HASH_MAP_WINDOW_SIZE Q_INT64_C(67108864) // 64 MiB
+    #endif
+#endif
+
+class QFileDevice;
+class QThreadPool;
+
+namespace qkeeg {
+
+namespace io {
+class BinaryReader;
+class BinaryWriter;
+class BufferPool;
+class PositionalReader;
+} // namespace io
+
+namespace hashing {
+
+//! A part of a file, length -1 reaches to the end of the file.
+struct ByteRange
+{
+    qint64 offset;
+    qint64 length;
+};
 
 class HashAlgorithm
 {
     Q_GADGET
 
 public:
+    //! How text is turned into bytes before hashing.
+    enum class TextEncoding { Utf8, Utf16 };
+
+    //! Called with bytesHashed() after every block read from a device or file. Returning false
+    //! stops hashing, the compute call then returns an empty array.
+    using ProgressCallback = std::function<bool(qint64 bytesDone)>;
+
     //! Virtual Destructor
     virtual ~HashAlgorithm();
 
     //! Compute hash of a byte array
     QByteArray computeHash(const QByteArray &data);
     QByteArray computeHash(const QByteArray &data, const qint32 &offset, const qint32 &count);
+    //! Compute hash of a raw memory span, without copying it.
+    QByteArray computeHash(const void *data, qint64 length);
+
+    //! Compute hash of text, see update(QStringView, TextEncoding).
+    QByteArray computeHash(QStringView text, TextEncoding encoding = TextEncoding::Utf8);
 
     //! Comput Hash of a stream
     QByteArray computeHash(QIODevice &instream);
+    //! Compute hash of a stream while a background thread reads ahead into bufferCount buffers,
+    //! so reading and hashing overlap. Pays off when hashing is about as slow as the device.
+    QByteArray computeHashPipelined(QIODevice &instream, int bufferCount = 4);
+    //! Compute hash of everything a sequential device (process, socket, pipe) delivers from its current
+    //! position until it ends, in constant memory. msecs limits how long to wait for more data, -1 waits
+    //! forever; running into it is an error.
+    QByteArray computeHashStream(QIODevice &instream, int msecs = -1);
+
+    //! Compute hash of length bytes of a seekable device starting at offset, -1 hashes to the end.
+    //! Files are read with positional reads, the device position is left untouched.
+    QByteArray computeHash(QIODevice &instream, qint64 offset, qint64 length);
+    //! Compute hash of length bytes of the file at path starting at offset, -1 hashes to the end.
+    QByteArray computeFileHash(const QString &path, qint64 offset = 0, qint64 length = -1);
+    //! Hash each range of a file on its own, concurrently on pool (the global pool if null).
+    //! Returns one digest per range in the same order; a range that can't be read gets an
+    //! empty digest. Works on clones, the state of this algorithm is left untouched.
+    QVector<QByteArray> computeHashRanges(const QString &path, const QVector<ByteRange> &ranges,
+                                          QThreadPool *pool = nullptr) const;
+    QVector<QByteArray> computeHashRanges(QIODevice &instream, const QVector<ByteRange> &ranges,
+                                          QThreadPool *pool = nullptr) const;
+
+    //! Compute hash of a whole seekable device like computeHash(QIODevice&), but only the data
+    //! extents of a sparse file are read; its holes are fed through updateZeros().
+    QByteArray computeHashSparse(QIODevice &instream);
+    QByteArray computeFileHashSparse(const QString &path);
+
+    //! Feed the next chunk of a message into the running hash. The data is not copied.
+    void update(const void *data, qint64 length);
+    void update(const QByteArray &data);
+    //! Feed count zero bytes, same result as update() with that many zeros.
+    void updateZeros(qint64 count);
+    //! Feed text into the running hash without allocating. Utf8 hashes the same bytes as
+    //! QString::toUtf8(), Utf16 hashes the code units in little endian order.
+    void update(QStringView text, TextEncoding encoding = TextEncoding::Utf8);
+    //! Finish the running hash, store it as the hash value and reset for the next message.
+    QByteArray finalize();
+    //! Finish the running hash into a caller supplied buffer of at least hashSize() / 8 bytes,
+    //! without allocating, and reset for the next message. hashValue() is left untouched.
+    void finalizeInto(void *out, std::size_t length);
+    template<std::size_t N>
+    void finalizeInto(Digest<N> &digest)
+    {
+        finalizeInto(digest.data(), digest.size());
+    }
+
+    //! True if combine() is supported, so the parts of a message can be hashed independently.
+    virtual bool isCombinable() const;
+    //! True if a message can be fed in any number of update() calls. False for algorithms that need
+    //! the whole message in a single update(); those only hash buffers, the device, file and stream
+    //! functions throw a QString for them.
+    virtual bool isIncremental() const;
+    //! Throws a QString unless isIncremental(), for code that feeds a message in parts.
+    void requireIncremental() const;
+    //! Append next, the same algorithm that hashed the data directly following this one's from a
+    //! reset state. Afterwards this holds the state of the whole message. Throws a QString if the
+    //! algorithms can't be combined.
+    void combine(const HashAlgorithm &next);
+
+    //! Hash n independent messages in one call. Digest i, hashSize() / 8 bytes, is written to
+    //! outDigests at offset i * hashSize() / 8. Resets the algorithm; hashValue() is left untouched.
+    void hashBatch(const void *const *ptrs, const std::size_t *lens, std::size_t n, void *outDigests);
 
     //! Make sure everything is setup, or reset.
     virtual void initialize() = 0;
+    //! initialize() and clear bytesHashed(), ready for a new message.
+    void reset();
 
     //! Size of the return hash in bits.
     virtual quint32 hashSize() = 0;
+    //! Copy of the algorithm including any in-progress state, so a shared prefix can be hashed once and forked.
+    virtual std::unique_ptr<HashAlgorithm> clone() const = 0;
+    //! Short lower case name of the algorithm, e.g. "sha256".
+    virtual QString name() const = 0;
+
+    //! Number of bytes fed through update() since the hash was last finished.
+    quint64 bytesHashed() const;
+    //! Export the in-progress state as a versioned, little endian blob.
+    QByteArray saveState() const;
+    //! Import a blob made by saveState() of the same algorithm. On failure the algorithm is reset.
+    bool restoreState(const QByteArray &state);
+    //! Restore state, then hash the device from bytesHashed() to its end. If updatedState is given it
+    //! receives the state at the end of the device, so append-only data can be extended later.
+    QByteArray resumeHash(QIODevice &instream, const QByteArray &state, QByteArray *updatedState = nullptr);
     //! Get the hash value as byte array.
     QByteArray hashValue() const;
     //! Get the hash value as a hex string.
@@ -66,23 +189,75 @@ public:
     //! Compute hash of a byte array
     QByteArray operator ()(const QByteArray &data);
 
+    //! Set or, with nullptr, clear the callback. It runs on the hashing thread, and is copied by clone().
+    void setProgressCallback(ProgressCallback callback);
+
+    //! Let computeHash() and resumeHash() hash local files of at least 256 KiB from memory mapped
+    //! windows instead of reading them. Off by default: if another process truncates a file while it
+    //! is mapped, e.g. logrotate's copytruncate, touching the lost pages raises SIGBUS and kills the
+    //! process. The size is checked before each window, which narrows that race but can't close it,
+    //! so only enable this for files nothing shrinks while they are hashed. Copied by clone().
+    void setMemoryMappingEnabled(bool enabled);
+    bool isMemoryMappingEnabled() const;
+
+    //! Process wide pool of the read buffers used when hashing devices and files. Its buffer size
+    //! starts out as HASH_BLOCK_BUFFER_SIZE and can be changed, like huge page use, at runtime.
+    static io::BufferPool &bufferPool();
+
 protected:
     //! Protected constructor for abstract class.
     HashAlgorithm();
 
     //! Hashing function that does the work. Must be implemented in the derived class.
-    virtual void hashCore(const void* data, const qint64 &offset, const qint64 &count) = 0;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) = 0;
 
     //! This is called to finalize the hash computation.
-    virtual QByteArray hashFinal() = 0;
+    virtual QByteArray hashFinal();
+
+    //! Write the final hash, hashSize() / 8 bytes, to hash. Must be implemented in the derived class.
+    virtual void hashFinalInto(void *hash) = 0;
+
+    //! Combine worker, nextLength is next.bytesHashed(). Only called if isCombinable().
+    virtual void combineCore(const HashAlgorithm &next, quint64 nextLength);
+
+    //! Feed count zero bytes. The default hashes one shared block of zeros over and over;
+    //! override where the state can be advanced over zeros directly.
+    virtual void hashZeros(qint64 count);
+
+    //! Batch worker, arguments are already validated. The default runs initialize(), hashCore() and
+    //! hashFinalInto() per message; override with an interleaved version where it pays off.
+    virtual void hashBatchCore(const void *const *ptrs, const std::size_t *lens, std::size_t n, quint8 *outDigests);
+
+    //! Write or read the algorithm specific part of the state blob.
+    virtual void writeState(io::BinaryWriter &writer) const = 0;
+    virtual bool readState(io::BinaryReader &reader) = 0;
 
     QString byteArrayToHex(const QByteArray &data, bool useUpperCase = true, bool insertSpaces = false);
 
 protected:
-    const qint64 m_blockSizeBuffer = HASH_BLOCK_BUFFER_SIZE;
     QByteArray m_hashValue;
+    quint64 m_bytesHashed = 0;
 
 private:
+    ProgressCallback m_progressCallback;
+    bool m_memoryMapping = false;
+
+    //! Feed bytesToRead bytes from the current device position.
+    bool updateFromDevice(QIODevice &instream, qint64 bytesToRead);
+    //! Hash up to bytesToRead bytes of a local file from its current position through memory mapped
+    //! windows. Returns the number of bytes hashed; 0 if the file is small or can't be mapped, -1
+    //! if the progress callback stopped it. Stops early if the file shrinks, see setMemoryMappingEnabled().
+    qint64 updateFromMappedFile(QFileDevice &file, qint64 bytesToRead);
+    bool updateFromStream(QIODevice &instream, int msecs);
+    //! False if the progress callback asks to stop.
+    bool reportProgress() const;
+    //! Feed length bytes from offset, read without a shared file position.
+    bool updateFromReader(io::PositionalReader &reader, qint64 offset, qint64 length);
+    QByteArray computeHash(io::PositionalReader &reader, qint64 offset, qint64 length);
+    QVector<QByteArray> computeHashRanges(io::PositionalReader &reader, const QVector<ByteRange> &ranges,
+                                          QThreadPool *pool) const;
+    QByteArray computeHashSparse(io::PositionalReader &reader);
+
     static_assert(std::is_same<quint8, unsigned char>::value,
                   "quint8 is required to be implemented as unsigned char!");
 };
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "hashalgorithmregistry.hpp"
+#include "checksum/adler32.hpp"
+#include "checksum/fletcher32.hpp"
+#include "crc/crc32.hpp"
+#include "crc/crc64.hpp"
+#include "cryptographic/keccak.hpp"
+#include "cryptographic/md5.hpp"
+#include "cryptographic/sha1.hpp"
+#include "cryptographic/sha256.hpp"
+#include "cryptographic/sha3.hpp"
+#include "noncryptographic/aphash32.hpp"
+#include "noncryptographic/bkdrhash32.hpp"
+#include "noncryptographic/djb2hash32.hpp"
+#include "noncryptographic/elfhash32.hpp"
+#include "noncryptographic/fnv1ahash32.hpp"
+#include "noncryptographic/fnv1ahash64.hpp"
+#include "noncryptographic/fnv1hash32.hpp"
+#include "noncryptographic/fnv1hash64.hpp"
+#include "noncryptographic/joaathash32.hpp"
+#include "noncryptographic/jshash32.hpp"
+#include "noncryptographic/pjwhash32.hpp"
+#include "noncryptographic/saxhash32.hpp"
+#include "noncryptographic/sdbmhash32.hpp"
+#include "noncryptographic/superfasthash32.hpp"
+#include "noncryptographic/xxhash32.hpp"
+#include "noncryptographic/xxhash64.hpp"
+#include <vector>
+
+namespace qkeeg { namespace hashing {
+
+namespace {
+
+using FreeList = QHash<QString, std::vector<std::unique_ptr<HashAlgorithm>>>;
+
+FreeList &threadFreeList()
+{
+    thread_local FreeList freeList;
+    return freeList;
+}
+
+template<class T, class... Args>
+HashAlgorithmRegistry::Factory makeFactory(Args... args)
+{
+    return [args...]() { return std::unique_ptr<HashAlgorithm>(new T(args...)); };
+}
+
+} // anonymous namespace
+
+HashAlgorithmRegistry &HashAlgorithmRegistry::instance()
+{
+    static HashAlgorithmRegistry registry;
+    return registry;
+}
+
+HashAlgorithmRegistry::HashAlgorithmRegistry()
+{
+    registerBuiltins();
+}
+
+bool HashAlgorithmRegistry::registerAlgorithm(const Entry &entry)
+{
+    if (entry.name.isEmpty() || !entry.factory) {
+        return false;
+    }
+
+    QStringList keys;
+    keys << entry.name.toLower();
+    for (const QString &alias : entry.aliases) {
+        keys << alias.toLower();
+    }
+    if (!entry.oid.isEmpty()) {
+        keys << entry.oid;
+    }
+
+    QWriteLocker lock(&m_lock);
+    for (const QString &key : keys) {
+        if (m_index.contains(key)) {
+            return false;
+        }
+    }
+
+    Entry added = entry;
+    if (added.hashSize == 0) {
+        added.hashSize = added.factory()->hashSize();
+    }
+
+    m_entries.append(added);
+    for (const QString &key : keys) {
+        m_index.insert(key, m_entries.size() - 1);
+    }
+
+    return true;
+}
+
+bool HashAlgorithmRegistry::contains(const QString &nameOrOid) const
+{
+    QReadLocker lock(&m_lock);
+    return m_index.contains(nameOrOid.toLower());
+}
+
+QStringList HashAlgorithmRegistry::names() const
+{
+    QReadLocker lock(&m_lock);
+    QStringList result;
+    for (const Entry &entry : m_entries) {
+        result << entry.name;
+    }
+
+    return result;
+}
+
+HashAlgorithmRegistry::Entry HashAlgorithmRegistry::entry(const QString &nameOrOid) const
+{
+    QReadLocker lock(&m_lock);
+    const int index = m_index.value(nameOrOid.toLower(), -1);
+    return (index < 0) ? Entry() : m_entries.at(index);
+}
+
+quint32 HashAlgorithmRegistry::hashSize(const QString &nameOrOid) const
+{
+    return entry(nameOrOid).hashSize;
+}
+
+quint32 HashAlgorithmRegistry::blockSize(const QString &nameOrOid) const
+{
+    return entry(nameOrOid).blockSize;
+}
+
+std::unique_ptr<HashAlgorithm> HashAlgorithmRegistry::create(const QString &nameOrOid) const
+{
+    Factory factory = entry(nameOrOid).factory;
+    return factory ? factory() : nullptr;
+}
+
+HashAlgorithmRegistry::Pooled HashAlgorithmRegistry::acquire(const QString &nameOrOid) const
+{
+    const Entry found = entry(nameOrOid);
+    if (!found.factory) {
+        return Pooled(nullptr, [](HashAlgorithm *) {});
+    }
+
+    std::unique_ptr<HashAlgorithm> algorithm;
+    auto &freeList = threadFreeList()[found.name];
+    if (!freeList.empty()) {
+        algorithm = std::move(freeList.back());
+        freeList.pop_back();
+    }
+    else {
+        algorithm = found.factory();
+    }
+
+    const QString name = found.name;
+    return Pooled(algorithm.release(), [name](HashAlgorithm *released) { recycle(name, released); });
+}
+
+void HashAlgorithmRegistry::recycle(const QString &name, HashAlgorithm *algorithm)
+{
+    std::unique_ptr<HashAlgorithm> owned(algorithm);
+    auto &freeList = threadFreeList()[name];
+    if (static_cast<int>(freeList.size()) < MaxPooledPerThread) {
+        // Hand the next user a clean instance, not the last user's callback and its captures.
+        owned->setProgressCallback(nullptr);
+        owned->setMemoryMappingEnabled(false);
+        owned->reset();
+        freeList.push_back(std::move(owned));
+    }
+}
+
+void HashAlgorithmRegistry::registerBuiltins()
+{
+    using namespace checksum;
+    using namespace crc;
+    using namespace cryptographic;
+    using namespace noncryptographic;
+
+    auto add = [this](const QString &name, const QStringList &aliases, const QString &oid,
+                      quint32 blockSize, const Factory &factory) {
+        Entry entry;
+        entry.name      = name;
+        entry.aliases   = aliases;
+        entry.oid       = oid;
+        entry.blockSize = blockSize;
+        entry.factory   = factory;
+        registerAlgorithm(entry);
+    };
+
+    add("crc32",  {"crc-32"}, QString(), 1, makeFactory<Crc32>());
+    // Uses the SSE 4.2 crc32 instruction when the CPU has it.
+    add("crc32c", {"crc-32c", "castagnoli"}, QString(), 1, makeFactory<Crc32>(CASTAGNOLI_POLYNOMIAL, UINT32_C(0)));
+    add("crc64",  {"crc-64"}, QString(), 1, makeFactory<Crc64>());
+
+    add("adler32",    {"adler-32"},    QString(), 1, makeFactory<Adler32>());
+    add("fletcher32", {"fletcher-32"}, QString(), 2, makeFactory<Fletcher32>());
+
+    add("aphash32",        {"ap"},            QString(), 1,  makeFactory<APHash32>());
+    add("bkdrhash32",      {"bkdr"},          QString(), 1,  makeFactory<BKDRHash32>());
+    add("djb2hash32",      {"djb2"},          QString(), 1,  makeFactory<Djb2Hash32>());
+    add("elfhash32",       {"elf"},           QString(), 1,  makeFactory<ElfHash32>());
+    add("fnv1hash32",      {"fnv1-32"},       QString(), 1,  makeFactory<Fnv1Hash32>());
+    add("fnv1hash64",      {"fnv1-64"},       QString(), 1,  makeFactory<Fnv1Hash64>());
+    add("fnv1ahash32",     {"fnv1a-32"},      QString(), 1,  makeFactory<Fnv1aHash32>());
+    add("fnv1ahash64",     {"fnv1a-64"},      QString(), 1,  makeFactory<Fnv1aHash64>());
+    add("joaathash32",     {"joaat"},         QString(), 1,  makeFactory<JOAATHash32>());
+    add("jshash32",        {"js"},            QString(), 1,  makeFactory<JSHash32>());
+    add("pjwhash32",       {"pjw"},           QString(), 1,  makeFactory<PJWHash32>());
+    add("saxhash32",       {"sax"},           QString(), 1,  makeFactory<SaxHash32>());
+    add("sdbmhash32",      {"sdbm"},          QString(), 1,  makeFactory<SDBMHash32>());
+    add("superfasthash32", {"superfasthash"}, QString(), 4,  makeFactory<SuperFastHash32>());
+    add("xxhash32",        {"xxh32"},         QString(), 16, makeFactory<XxHash32>());
+    add("xxhash64",        {"xxh64"},         QString(), 32, makeFactory<XxHash64>());
+
+    add("md5",    {},                     "1.2.840.113549.2.5",     64, makeFactory<Md5>());
+    add("sha1",   {"sha-1"},              "1.3.14.3.2.26",          64, makeFactory<Sha1>());
+    add("sha256", {"sha-256", "sha2-256"}, "2.16.840.1.101.3.4.2.1", 64, makeFactory<Sha256>());
+
+    // rate of the sponge in bytes, 200 - 2 * digest bytes
+    add("sha3-224", {"sha3_224"}, "2.16.840.1.101.3.4.2.7",  144, makeFactory<Sha3>(Sha3::Bits::Bits224));
+    add("sha3-256", {"sha3_256"}, "2.16.840.1.101.3.4.2.8",  136, makeFactory<Sha3>(Sha3::Bits::Bits256));
+    add("sha3-384", {"sha3_384"}, "2.16.840.1.101.3.4.2.9",  104, makeFactory<Sha3>(Sha3::Bits::Bits384));
+    add("sha3-512", {"sha3_512"}, "2.16.840.1.101.3.4.2.10", 72,  makeFactory<Sha3>(Sha3::Bits::Bits512));
+
+    add("keccak-224", {"keccak224"}, QString(), 144, makeFactory<Keccak>(Keccak::Bits::Bits224));
+    add("keccak-256", {"keccak256"}, QString(), 136, makeFactory<Keccak>(Keccak::Bits::Bits256));
+    add("keccak-384", {"keccak384"}, QString(), 104, makeFactory<Keccak>(Keccak::Bits::Bits384));
+    add("keccak-512", {"keccak512"}, QString(), 72,  makeFactory<Keccak>(Keccak::Bits::Bits512));
+}
+
+} // namespace hashing
+} // namespace qkeeg
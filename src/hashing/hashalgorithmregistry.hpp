@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef HASHALGORITHMREGISTRY_HPP
+#define HASHALGORITHMREGISTRY_HPP
+
+#include "hashalgorithm.hpp"
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+namespace qkeeg { namespace hashing {
+
+//! Maps algorithm names, aliases and OIDs to factories.
+class HashAlgorithmRegistry
+{
+    Q_GADGET
+
+public:
+    using Factory = std::function<std::unique_ptr<HashAlgorithm>()>;
+    //! Instance from acquire(), handed back to the calling thread's free-list when it is destroyed.
+    using Pooled = std::unique_ptr<HashAlgorithm, std::function<void(HashAlgorithm*)>>;
+
+    struct Entry
+    {
+        QString     name;
+        QStringList aliases;
+        QString     oid;
+        //! Digest size in bits.
+        quint32     hashSize = 0;
+        //! Preferred input block size in bytes.
+        quint32     blockSize = 0;
+        Factory     factory;
+    };
+
+    //! Process wide registry, populated with every built-in algorithm.
+    static HashAlgorithmRegistry &instance();
+
+    //! Add an algorithm. Returns false if the name, an alias or the OID is already taken.
+    bool registerAlgorithm(const Entry &entry);
+
+    bool contains(const QString &nameOrOid) const;
+    //! Canonical names of all registered algorithms.
+    QStringList names() const;
+    //! Look up by name, alias or OID (case insensitive). Returns an entry without factory if unknown.
+    Entry entry(const QString &nameOrOid) const;
+    quint32 hashSize(const QString &nameOrOid) const;
+    quint32 blockSize(const QString &nameOrOid) const;
+
+    //! New instance, or nullptr if unknown.
+    std::unique_ptr<HashAlgorithm> create(const QString &nameOrOid) const;
+    //! Ready to use instance from the calling thread's free-list, or a new one. nullptr if unknown.
+    //! Pooled instances come back reset, without a progress callback and with mapping disabled.
+    Pooled acquire(const QString &nameOrOid) const;
+
+private:
+    HashAlgorithmRegistry();
+    Q_DISABLE_COPY(HashAlgorithmRegistry)
+
+    void registerBuiltins();
+    static void recycle(const QString &name, HashAlgorithm *algorithm);
+
+    /// Max number of idle instances per algorithm and thread.
+    static const int MaxPooledPerThread = 8;
+
+    mutable QReadWriteLock m_lock;
+    QVector<Entry>         m_entries;
+    /// lower case name, alias and OID to index in m_entries
+    QHash<QString, int>    m_index;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // HASHALGORITHMREGISTRY_HPP
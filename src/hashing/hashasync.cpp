@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "hashasync.hpp"
+#include "hashalgorithmregistry.hpp"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFutureInterface>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+namespace qkeeg { namespace hashing {
+
+namespace {
+
+/// Hashes one file or device and reports into a future.
+class HashTask : public QRunnable
+{
+public:
+    HashTask(const QFutureInterface<QByteArray> &interface, std::unique_ptr<HashAlgorithm> algorithm,
+             const QString &path, QIODevice *device) :
+        m_interface(interface), m_algorithm(std::move(algorithm)), m_path(path), m_device(device)
+    {
+
+    }
+
+    void run() override
+    {
+        if (m_interface.isCanceled()) {
+            m_interface.reportFinished();
+            return;
+        }
+
+        // Opened here, so the file belongs to the pool thread.
+        QFile file;
+        QIODevice *device = m_device;
+        if (device == nullptr) {
+            file.setFileName(m_path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                m_interface.reportResult(QByteArray());
+                m_interface.reportFinished();
+                return;
+            }
+            device = &file;
+        }
+
+        const qint64 total = device->size();
+        QElapsedTimer timer;
+        timer.start();
+        m_algorithm->setProgressCallback([this, total, &timer](qint64 bytesDone) {
+            if ((total > 0) && (timer.elapsed() >= HashProgressInterval)) {
+                timer.restart();
+                m_interface.setProgressValue(static_cast<int>((bytesDone * HashProgressMaximum) / total));
+            }
+            return !m_interface.isCanceled();
+        });
+
+        QByteArray digest;
+        try {
+            digest = m_algorithm->computeHash(*device);
+        }
+        catch (const QString &) {
+            digest.clear();
+        }
+
+        if (!m_interface.isCanceled()) {
+            m_interface.setProgressValue(HashProgressMaximum);
+            m_interface.reportResult(digest);
+        }
+        m_interface.reportFinished();
+    }
+
+private:
+    QFutureInterface<QByteArray> m_interface;
+    std::unique_ptr<HashAlgorithm> m_algorithm;
+    QString m_path;
+    QIODevice *m_device;
+};
+
+QFuture<QByteArray> startHash(std::unique_ptr<HashAlgorithm> algorithm, const QString &path, QIODevice *device)
+{
+    // Here rather than on the pool thread, where it could only end up as an empty digest.
+    algorithm->requireIncremental();
+    algorithm->reset();
+
+    QFutureInterface<QByteArray> interface;
+    interface.setThreadPool(hashThreadPool());
+    interface.setProgressRange(0, HashProgressMaximum);
+    interface.reportStarted();
+
+    QFuture<QByteArray> future = interface.future();
+    hashThreadPool()->start(new HashTask(interface, std::move(algorithm), path, device));
+    return future;
+}
+
+std::unique_ptr<HashAlgorithm> createAlgorithm(const QString &name)
+{
+    std::unique_ptr<HashAlgorithm> algorithm = HashAlgorithmRegistry::instance().create(name);
+    if (!algorithm) {
+        throw QString("Unknown hash algorithm: %1").arg(name);
+    }
+
+    return algorithm;
+}
+
+} // anonymous namespace
+
+QThreadPool *hashThreadPool()
+{
+    // Never deleted, hashes may still be running while static objects are destroyed.
+    static QThreadPool *pool = []() {
+        QThreadPool *threadPool = new QThreadPool();
+        threadPool->setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+        return threadPool;
+    }();
+    return pool;
+}
+
+QFuture<QByteArray> hashAsync(const QString &path, const HashAlgorithm &algorithm)
+{
+    return startHash(algorithm.clone(), path, nullptr);
+}
+
+QFuture<QByteArray> hashAsync(const QString &path, const QString &algorithm)
+{
+    return startHash(createAlgorithm(algorithm), path, nullptr);
+}
+
+QFuture<QByteArray> hashAsync(QIODevice &device, const HashAlgorithm &algorithm)
+{
+    return startHash(algorithm.clone(), QString(), &device);
+}
+
+QFuture<QByteArray> hashAsync(QIODevice &device, const QString &algorithm)
+{
+    return startHash(createAlgorithm(algorithm), QString(), &device);
+}
+
+} // namespace hashing
+} // namespace qkeeg
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef HASHASYNC_HPP
+#define HASHASYNC_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QFuture>
+#include <QIODevice>
+#include <QString>
+
+class QThreadPool;
+
+namespace qkeeg { namespace hashing {
+
+//! QFuture::progressValue() of a hashAsync() future runs from 0 to this, in steps of 0.1%.
+const int HashProgressMaximum = 1000;
+//! Progress is reported at most once per this many milliseconds.
+const int HashProgressInterval = 100;
+
+//! Thread pool hashAsync() runs on. Separate from QThreadPool::globalInstance() so long hashes
+//! never hold up other work, and bounded to QThread::idealThreadCount() threads; the bound can
+//! be changed with setMaxThreadCount().
+QThreadPool *hashThreadPool();
+
+//! Hash the file at path with a copy of algorithm on hashThreadPool(). The future holds the digest,
+//! empty if the file can't be read. QFuture::cancel() stops hashing at the next block, a canceled
+//! future has no result. Throws a QString if the algorithm isn't isIncremental().
+QFuture<QByteArray> hashAsync(const QString &path, const HashAlgorithm &algorithm);
+//! Same with an algorithm from the registry. Throws a QString for unknown names.
+QFuture<QByteArray> hashAsync(const QString &path, const QString &algorithm);
+//! Hash a seekable device. It is read on a pool thread, so it must not be touched, and must stay
+//! alive, until the future has finished.
+QFuture<QByteArray> hashAsync(QIODevice &device, const HashAlgorithm &algorithm);
+QFuture<QByteArray> hashAsync(QIODevice &device, const QString &algorithm);
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // HASHASYNC_HPP
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef HASHER_HPP
+#define HASHER_HPP
+
+#include <QtGlobal>
+#include <cstddef>
+
+namespace qkeeg { namespace hashing {
+
+//! Non virtual front end for the byte at a time algorithms, e.g. Hasher<noncryptographic::Fnv1aHash32>.
+//! Everything is inline, so loops over many keys get the core inlined and its constants propagated.
+//! Algo::Core provides State, Result and the static initialState(), updateState() and finalState();
+//! the HashAlgorithm class of the same algorithm is a thin adapter over that core.
+template<class Algo>
+class Hasher
+{
+public:
+    using Core   = typename Algo::Core;
+    using State  = typename Core::State;
+    using Result = typename Core::Result;
+
+    Hasher() Q_DECL_NOEXCEPT : m_state(Core::initialState()) { }
+    //! Start from a given state, e.g. a seeded one.
+    explicit Hasher(State state) Q_DECL_NOEXCEPT : m_state(state) { }
+
+    void update(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+    {
+        Core::updateState(m_state, static_cast<const quint8*>(data), length);
+    }
+
+    //! Finish the running hash and reset for the next message.
+    Result finalize() Q_DECL_NOEXCEPT
+    {
+        const Result result = Core::finalState(m_state);
+        m_state = Core::initialState();
+        return result;
+    }
+
+    void reset() Q_DECL_NOEXCEPT
+    {
+        m_state = Core::initialState();
+    }
+
+    State state() const Q_DECL_NOEXCEPT
+    {
+        return m_state;
+    }
+
+    //! One-shot hash of a buffer.
+    static Result hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+    {
+        State state = Core::initialState();
+        Core::updateState(state, static_cast<const quint8*>(data), length);
+        return Core::finalState(state);
+    }
+
+private:
+    State m_state;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // HASHER_HPP
@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "hashwatcher.hpp"
+#include "hashalgorithmregistry.hpp"
+#include "crc/crc64.hpp"
+#include "../io/bufferpool.hpp"
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace qkeeg { namespace hashing {
+
+namespace {
+
+#ifdef Q_OS_LINUX
+const quint32 WatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+#endif
+
+QString parentOf(const QString &path)
+{
+    return QFileInfo(path).absolutePath();
+}
+
+bool isBelow(const QString &path, const QString &directory)
+{
+    return (path == directory) || path.startsWith(directory + QLatin1Char('/'));
+}
+
+//! Same file, same contents as far as stat can tell.
+bool sameVersion(const DigestCache::Key &a, const DigestCache::Key &b)
+{
+    return (a.device == b.device) && (a.inode == b.inode) && (a.size == b.size) && (a.mtimeNs == b.mtimeNs);
+}
+
+//! CRC64 of the last TailCheckSize bytes before size, false if they can't be read. A CRC catches
+//! every change this short for sure.
+bool hashTail(QFile &device, qint64 size, quint64 &hash)
+{
+    const qint64 tailSize = qMin(static_cast<qint64>(HashWatcher::TailCheckSize), size);
+    if (!device.seek(size - tailSize)) {
+        return false;
+    }
+    const QByteArray tail = device.read(tailSize);
+    if (tail.size() != tailSize) {
+        return false;
+    }
+    hash = crc::Crc64::hash(tail.constData(), static_cast<std::size_t>(tail.size()));
+    return true;
+}
+
+} // anonymous namespace
+
+HashWatcher::HashWatcher(const HashAlgorithm &algorithm, QObject *parent) :
+    QObject(parent), m_algorithm(algorithm.clone())
+{
+    initialize();
+}
+
+HashWatcher::HashWatcher(const QString &algorithm, QObject *parent) :
+    QObject(parent)
+{
+    m_algorithm = HashAlgorithmRegistry::instance().create(algorithm);
+    if (!m_algorithm) {
+        throw QString("Unknown hash algorithm: %1").arg(algorithm);
+    }
+
+    initialize();
+}
+
+HashWatcher::~HashWatcher()
+{
+    delete m_notifier;
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+#endif
+}
+
+void HashWatcher::initialize()
+{
+    m_algorithm->requireIncremental();
+    m_algorithm->setProgressCallback(nullptr);
+
+    m_debounce.setSingleShot(true);
+    connect(&m_debounce, &QTimer::timeout, this, [this]() { processPending(); });
+
+#ifdef Q_OS_LINUX
+    m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd >= 0) {
+        m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, [this]() { readEvents(); });
+    }
+#endif
+}
+
+bool HashWatcher::addPath(const QString &path)
+{
+    const QFileInfo info(path);
+    const QString absolutePath = info.absoluteFilePath();
+    if (info.isDir()) {
+        return watchDirectory(absolutePath, true);
+    }
+
+    if (info.isFile()) {
+        watchFile(absolutePath);
+        return true;
+    }
+
+    return false;
+}
+
+void HashWatcher::removePath(const QString &path)
+{
+    const QString absolutePath = QFileInfo(path).absoluteFilePath();
+    unwatch(absolutePath);
+
+    for (auto it = m_files.begin(); it != m_files.end();) {
+        if (isBelow(it.key(), absolutePath)) {
+            if (m_fallback != nullptr) {
+                m_fallback->removePath(it.key());
+            }
+            m_pending.remove(it.key());
+            it = m_files.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    releaseWatch(parentOf(absolutePath));
+}
+
+int HashWatcher::debounceInterval() const
+{
+    return m_debounceInterval;
+}
+
+void HashWatcher::setDebounceInterval(int msecs)
+{
+    m_debounceInterval = qMax(msecs, 0);
+}
+
+bool HashWatcher::usesInotify() const
+{
+    return (m_inotifyFd >= 0) && (m_fallback == nullptr);
+}
+
+QByteArray HashWatcher::digest(const QString &path) const
+{
+    return m_files.value(QFileInfo(path).absoluteFilePath()).digest;
+}
+
+QStringList HashWatcher::files() const
+{
+    QStringList paths = m_files.keys();
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool HashWatcher::addWatch(const QString &directory)
+{
+    if (m_watchIds.contains(directory)) {
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        const int id = ::inotify_add_watch(m_inotifyFd, QFile::encodeName(directory).constData(), WatchMask);
+        if (id >= 0) {
+            m_watchIds.insert(directory, id);
+            m_watchPaths.insert(id, directory);
+            return true;
+        }
+    }
+#endif
+
+    // No inotify, or out of watches (fs.inotify.max_user_watches).
+    if (!fallback()->addPath(directory)) {
+        return false;
+    }
+    m_watchIds.insert(directory, -1);
+    return true;
+}
+
+void HashWatcher::releaseWatch(const QString &directory)
+{
+    if (!m_watchIds.contains(directory) || m_trees.contains(directory)) {
+        return;
+    }
+
+    for (auto it = m_files.constBegin(); it != m_files.constEnd(); ++it) {
+        if (parentOf(it.key()) == directory) {
+            return;
+        }
+    }
+
+    const int id = m_watchIds.take(directory);
+    if (id < 0) {
+        fallback()->removePath(directory);
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    m_watchPaths.remove(id);
+    ::inotify_rm_watch(m_inotifyFd, id);
+#endif
+}
+
+QFileSystemWatcher *HashWatcher::fallback()
+{
+    if (m_fallback == nullptr) {
+        m_fallback = new QFileSystemWatcher(this);
+        connect(m_fallback, &QFileSystemWatcher::fileChanged, this, [this](const QString &path) { schedule(path); });
+        connect(m_fallback, &QFileSystemWatcher::directoryChanged, this,
+                [this](const QString &path) { directoryChanged(path); });
+    }
+
+    return m_fallback;
+}
+
+bool HashWatcher::watchDirectory(const QString &path, bool baseline)
+{
+    if (!addWatch(path)) {
+        return false;
+    }
+    m_trees.insert(path);
+
+    const QFileInfoList entries = QDir(path).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot |
+                                                           QDir::Hidden | QDir::System | QDir::NoSymLinks, QDir::Name);
+    for (const QFileInfo &entry : entries) {
+        const QString entryPath = entry.absoluteFilePath();
+        if (entry.isDir()) {
+            if (!m_trees.contains(entryPath)) {
+                watchDirectory(entryPath, baseline);
+            }
+        }
+        else if (baseline) {
+            watchFile(entryPath);
+        }
+        else {
+            // Turned up after the baseline, reported as new.
+            if (m_watchIds.value(path) < 0) {
+                fallback()->addPath(entryPath);
+            }
+            schedule(entryPath);
+        }
+    }
+
+    return true;
+}
+
+void HashWatcher::watchFile(const QString &path)
+{
+    // inotify reports writes on the directory watch. QFileSystemWatcher only sees entries come and
+    // go there, so it watches the file too.
+    const QString directory = parentOf(path);
+    if (addWatch(directory) && (m_watchIds.value(directory) < 0)) {
+        fallback()->addPath(path);
+    }
+
+    FileState file;
+    hashFile(path, nullptr, file);
+    m_files.insert(path, file);
+}
+
+void HashWatcher::unwatch(const QString &path)
+{
+    for (auto it = m_trees.begin(); it != m_trees.end();) {
+        if (isBelow(*it, path)) {
+            it = m_trees.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    for (auto it = m_watchIds.begin(); it != m_watchIds.end();) {
+        if (!isBelow(it.key(), path)) {
+            ++it;
+            continue;
+        }
+
+        if (it.value() < 0) {
+            fallback()->removePath(it.key());
+        }
+#ifdef Q_OS_LINUX
+        else {
+            m_watchPaths.remove(it.value());
+            ::inotify_rm_watch(m_inotifyFd, it.value());
+        }
+#endif
+        it = m_watchIds.erase(it);
+    }
+}
+
+void HashWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        const ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+            if ((event->mask & IN_Q_OVERFLOW) != 0) {
+                // Events were lost, look at everything.
+                const QStringList trees = m_trees.values();
+                for (const QString &tree : trees) {
+                    directoryChanged(tree);
+                }
+                for (auto it = m_files.constBegin(); it != m_files.constEnd(); ++it) {
+                    schedule(it.key());
+                }
+                continue;
+            }
+
+            const QString directory = m_watchPaths.value(event->wd);
+            if (directory.isEmpty()) {
+                continue;
+            }
+
+            if ((event->mask & IN_IGNORED) != 0) {
+                m_watchPaths.remove(event->wd);
+                m_watchIds.remove(directory);
+                continue;
+            }
+
+            if (event->len == 0) {
+                continue;
+            }
+
+            const QString path = directory + QLatin1Char('/') + QFile::decodeName(event->name);
+            if ((event->mask & IN_ISDIR) != 0) {
+                if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+                    if (m_trees.contains(directory)) {
+                        watchDirectory(path, false);
+                    }
+                }
+                else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+                    directoryGone(path);
+                }
+            }
+            else if (isWatched(path)) {
+                schedule(path);
+            }
+        }
+    }
+#endif
+}
+
+void HashWatcher::directoryChanged(const QString &path)
+{
+    if (!QFileInfo(path).isDir()) {
+        directoryGone(path);
+        return;
+    }
+
+    // QFileSystemWatcher doesn't say what changed. Files that didn't are skipped by processPending().
+    if (m_trees.contains(path)) {
+        const QFileInfoList entries = QDir(path).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot |
+                                                               QDir::Hidden | QDir::System | QDir::NoSymLinks);
+        for (const QFileInfo &entry : entries) {
+            const QString entryPath = entry.absoluteFilePath();
+            if (!entry.isDir()) {
+                schedule(entryPath);
+            }
+            else if (!m_trees.contains(entryPath)) {
+                watchDirectory(entryPath, false);
+            }
+        }
+
+        const QStringList trees = m_trees.values();
+        for (const QString &tree : trees) {
+            if ((parentOf(tree) == path) && (tree != path) && !QFileInfo(tree).isDir()) {
+                directoryGone(tree);
+            }
+        }
+    }
+
+    for (auto it = m_files.constBegin(); it != m_files.constEnd(); ++it) {
+        if (parentOf(it.key()) == path) {
+            schedule(it.key());
+        }
+    }
+}
+
+void HashWatcher::directoryGone(const QString &path)
+{
+    // The files are reported as removed once processPending() finds them missing.
+    for (auto it = m_files.constBegin(); it != m_files.constEnd(); ++it) {
+        if (isBelow(it.key(), path)) {
+            schedule(it.key());
+        }
+    }
+
+    unwatch(path);
+}
+
+void HashWatcher::schedule(const QString &path)
+{
+    m_pending.insert(path);
+
+    // Wait for a quiet debounceInterval(), but not forever while events keep coming.
+    if (!m_debounce.isActive()) {
+        m_burst.start();
+        m_debounce.start(m_debounceInterval);
+    }
+    else if ((m_burst.elapsed() + m_debounceInterval) <= (static_cast<qint64>(MaxDebounceIntervals) * m_debounceInterval)) {
+        m_debounce.start(m_debounceInterval);
+    }
+}
+
+void HashWatcher::processPending()
+{
+    QStringList paths = m_pending.values();
+    std::sort(paths.begin(), paths.end());
+    m_pending.clear();
+
+    for (const QString &path : paths) {
+        // A slot may have removed it in the meantime.
+        if (!isWatched(path)) {
+            continue;
+        }
+
+        const auto previous = m_files.constFind(path);
+        const bool known = (previous != m_files.constEnd());
+        const DigestCache::Key key = DigestCache::makeKey(path, 0);
+        if (!key.isValid()) {
+            if (known) {
+                m_files.remove(path);
+                if (m_fallback != nullptr) {
+                    m_fallback->removePath(path);
+                }
+                emit fileRemoved(path);
+            }
+            continue;
+        }
+
+        if (known && sameVersion(key, previous->key)) {
+            continue;
+        }
+
+        FileState file;
+        hashFile(path, known ? &previous.value() : nullptr, file);
+        const bool changed = !known || (file.digest != previous->digest);
+        m_files.insert(path, file);
+        if (changed) {
+            emit digestChanged(path, file.digest);
+        }
+    }
+}
+
+bool HashWatcher::isWatched(const QString &path) const
+{
+    return m_files.contains(path) || m_trees.contains(parentOf(path));
+}
+
+bool HashWatcher::canResume(const FileState &previous, const DigestCache::Key &key, QFile &device) const
+{
+    if (previous.state.isEmpty() || (key.device != previous.key.device) || (key.inode != previous.key.inode) ||
+        (key.size <= previous.key.size)) {
+        return false;
+    }
+
+    // Appended to, not rewritten: the end of what was hashed last time is still there.
+    quint64 tailHash;
+    return hashTail(device, previous.key.size, tailHash) && (tailHash == previous.tailHash);
+}
+
+bool HashWatcher::hashFile(const QString &path, const FileState *previous, FileState &file)
+{
+    file.key = DigestCache::makeKey(path, 0);
+    QFile device(path);
+    if (!file.key.isValid() || !device.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Plain reads, never a mapping: a watched file may well be truncated while it is hashed.
+    const bool resumed = (previous != nullptr) && canResume(*previous, file.key, device) &&
+                         m_algorithm->restoreState(previous->state);
+    if (!resumed) {
+        m_algorithm->reset();
+    }
+    if (!device.seek(static_cast<qint64>(m_algorithm->bytesHashed()))) {
+        m_algorithm->reset();
+        return false;
+    }
+
+    io::BufferPool::Buffer buffer = HashAlgorithm::bufferPool().acquire();
+    qint64 numBytesRead;
+    while ((numBytesRead = device.read(buffer.data(), buffer.size())) > 0) {
+        m_algorithm->update(buffer.data(), numBytesRead);
+    }
+    if (numBytesRead < 0) {
+        m_algorithm->reset();
+        file.state.clear();
+        return false;
+    }
+
+    file.state = m_algorithm->saveState();
+    file.digest = m_algorithm->finalize();
+
+    // Written to while it was read: the digest is of no particular version, look again later.
+    if (!sameVersion(DigestCache::makeKey(path, 0), file.key)) {
+        file.state.clear();
+        schedule(path);
+        return true;
+    }
+
+    if (!file.state.isEmpty() && !hashTail(device, file.key.size, file.tailHash)) {
+        file.state.clear();
+    }
+
+    return true;
+}
+
+} // namespace hashing
+} // namespace qkeeg
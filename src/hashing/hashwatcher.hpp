@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef HASHWATCHER_HPP
+#define HASHWATCHER_HPP
+
+#include "digestcache.hpp"
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+class QFileSystemWatcher;
+class QSocketNotifier;
+
+namespace qkeeg { namespace hashing {
+
+//! Keeps the digests of watched files up to date and reports the ones that change. On Linux
+//! files are watched with inotify (IN_CLOSE_WRITE, IN_MOVED_TO), elsewhere, or if inotify is out
+//! of watches, with QFileSystemWatcher. Events are collected until none came in for
+//! debounceInterval() ms, then only the files touched are hashed again. A file that only grew is
+//! resumed from the saved state of its last hash, so appending to a log costs the new tail only.
+//! Files are read, never memory mapped, so one truncated while it is hashed can't raise SIGBUS.
+//! Hashing runs on the thread the watcher lives in; move it to a worker thread for large trees.
+class HashWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DefaultDebounceInterval = 500;
+    //! A burst of events never holds hashing back longer than this many debounce intervals.
+    static const int MaxDebounceIntervals = 10;
+    //! Bytes before the old end of a grown file that must be unchanged for it to count as appended to.
+    static const int TailCheckSize = 4096;
+
+    //! Files are hashed with a copy of algorithm. Throws a QString if it isn't isIncremental().
+    explicit HashWatcher(const HashAlgorithm &algorithm, QObject *parent = nullptr);
+    //! Creates the algorithm from the registry. Throws a QString for unknown names
+    //! and for algorithms that aren't isIncremental().
+    explicit HashWatcher(const QString &algorithm, QObject *parent = nullptr);
+    ~HashWatcher() override;
+
+    //! Watch a file, or every file below a directory including ones added later. Files already
+    //! there are hashed right away, without notifications, as the baseline changes are seen against.
+    bool addPath(const QString &path);
+    //! Stop watching path, and everything below it.
+    void removePath(const QString &path);
+
+    int debounceInterval() const;
+    void setDebounceInterval(int msecs);
+    //! True if changes are seen through inotify.
+    bool usesInotify() const;
+
+    //! Last digest of a watched file, empty if it isn't watched or couldn't be read.
+    QByteArray digest(const QString &path) const;
+    QStringList files() const;
+
+signals:
+    //! A watched file has a new digest, or a new file turned up below a watched directory.
+    void digestChanged(const QString &path, const QByteArray &digest);
+    //! A watched file was deleted or moved away.
+    void fileRemoved(const QString &path);
+
+private:
+    struct FileState
+    {
+        DigestCache::Key key;
+        QByteArray digest;
+        //! saveState() at the end of the file, empty if it can't be resumed.
+        QByteArray state;
+        //! CRC64 of the last bytes hashed, compared before resuming. Only set along with state.
+        quint64 tailHash = 0;
+    };
+
+    void initialize();
+    bool addWatch(const QString &directory);
+    void releaseWatch(const QString &directory);
+    QFileSystemWatcher *fallback();
+    bool watchDirectory(const QString &path, bool baseline);
+    void watchFile(const QString &path);
+    void unwatch(const QString &path);
+    void readEvents();
+    void directoryChanged(const QString &path);
+    void directoryGone(const QString &path);
+    void schedule(const QString &path);
+    void processPending();
+    bool isWatched(const QString &path) const;
+    bool canResume(const FileState &previous, const DigestCache::Key &key, QFile &device) const;
+    bool hashFile(const QString &path, const FileState *previous, FileState &file);
+
+    std::unique_ptr<HashAlgorithm> m_algorithm;
+    QHash<QString, FileState> m_files;
+    //! Directories every file of which is watched.
+    QSet<QString> m_trees;
+    QSet<QString> m_pending;
+    QTimer        m_debounce;
+    QElapsedTimer m_burst;
+    int           m_debounceInterval = DefaultDebounceInterval;
+
+    int              m_inotifyFd = -1;
+    QSocketNotifier *m_notifier  = nullptr;
+    QHash<int, QString> m_watchPaths;
+    QHash<QString, int> m_watchIds;
+    QFileSystemWatcher *m_fallback = nullptr;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // HASHWATCHER_HPP
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "multihasher.hpp"
+#include "hashalgorithmregistry.hpp"
+#include "../io/bufferpool.hpp"
+#include <QFuture>
+#include <QtConcurrent>
+
+namespace qkeeg { namespace hashing {
+
+MultiHasher::MultiHasher()
+{
+
+}
+
+MultiHasher::MultiHasher(std::vector<std::unique_ptr<HashAlgorithm>> algorithms) :
+    m_algorithms(std::move(algorithms))
+{
+    for (const std::unique_ptr<HashAlgorithm> &algorithm : m_algorithms) {
+        if (!algorithm) {
+            throw QString("Algorithm is null.");
+        }
+        algorithm->requireIncremental();
+    }
+}
+
+MultiHasher::MultiHasher(const QStringList &names)
+{
+    for (const QString &name : names) {
+        std::unique_ptr<HashAlgorithm> algorithm = HashAlgorithmRegistry::instance().create(name);
+        if (!algorithm) {
+            throw QString("Unknown hash algorithm: %1").arg(name);
+        }
+        algorithm->requireIncremental();
+
+        m_algorithms.push_back(std::move(algorithm));
+    }
+}
+
+MultiHasher::~MultiHasher()
+{
+
+}
+
+void MultiHasher::addAlgorithm(std::unique_ptr<HashAlgorithm> algorithm)
+{
+    if (!algorithm) {
+        throw QString("Algorithm is null.");
+    }
+    algorithm->requireIncremental();
+
+    m_algorithms.push_back(std::move(algorithm));
+}
+
+int MultiHasher::count() const
+{
+    return static_cast<int>(m_algorithms.size());
+}
+
+HashAlgorithm &MultiHasher::algorithm(int index)
+{
+    return *m_algorithms.at(static_cast<std::size_t>(index));
+}
+
+const HashAlgorithm &MultiHasher::algorithm(int index) const
+{
+    return *m_algorithms.at(static_cast<std::size_t>(index));
+}
+
+bool MultiHasher::isParallel() const
+{
+    return m_parallel;
+}
+
+void MultiHasher::setParallel(bool parallel)
+{
+    m_parallel = parallel;
+}
+
+QVector<QByteArray> MultiHasher::computeHash(const QByteArray &data)
+{
+    return computeHash(data.constData(), data.size());
+}
+
+QVector<QByteArray> MultiHasher::computeHash(const void *data, qint64 length)
+{
+    reset();
+    update(data, length);
+    return finalize();
+}
+
+QVector<QByteArray> MultiHasher::computeHash(QIODevice &instream)
+{
+    if (!instream.isReadable()) {
+        return QVector<QByteArray>();
+    }
+
+    instream.seek(0);
+    reset();
+
+    io::BufferPool &pool = HashAlgorithm::bufferPool();
+    qint64 bytesToRead = instream.size();
+    const qint64 blockSize = qMin(bytesToRead, pool.bufferSize());
+    if (!useThreads(blockSize)) {
+        io::BufferPool::Buffer buffer = pool.acquire();
+        while (bytesToRead > 0) {
+            qint64 numBytesRead = instream.read(buffer.data(), qMin(bytesToRead, buffer.size()));
+            if (numBytesRead <= 0) {
+                reset();
+                return QVector<QByteArray>();
+            }
+
+            update(buffer.data(), numBytesRead);
+            bytesToRead -= numBytesRead;
+        }
+
+        return finalize();
+    }
+
+    // Double buffered: the algorithms hash one block while the next is read into the other.
+    io::BufferPool::Buffer buffers[2] = { pool.acquire(), pool.acquire() };
+    QFuture<void> pending;
+    int current = 0;
+    bool readFailed = false;
+    while (bytesToRead > 0) {
+        const char *block = buffers[current].data();
+        qint64 numBytesRead = instream.read(buffers[current].data(), qMin(bytesToRead, buffers[current].size()));
+        pending.waitForFinished();
+        if (numBytesRead <= 0) {
+            readFailed = true;
+            break;
+        }
+
+        pending = QtConcurrent::map(m_algorithms, [block, numBytesRead](std::unique_ptr<HashAlgorithm> &algorithm) {
+            algorithm->update(block, numBytesRead);
+        });
+        bytesToRead -= numBytesRead;
+        current ^= 1;
+    }
+
+    pending.waitForFinished();
+    if (readFailed) {
+        reset();
+        return QVector<QByteArray>();
+    }
+
+    return finalize();
+}
+
+void MultiHasher::update(const void *data, qint64 length)
+{
+    // Validate up front so worker threads never throw.
+    if (length < 0) {
+        throw QString("Invalid length.");
+    }
+    if (length == 0) {
+        return;
+    }
+    if (data == nullptr) {
+        throw QString("Data pointer is null.");
+    }
+
+    if (!useThreads(length)) {
+        for (auto &algorithm : m_algorithms) {
+            algorithm->update(data, length);
+        }
+        return;
+    }
+
+    QtConcurrent::blockingMap(m_algorithms, [data, length](std::unique_ptr<HashAlgorithm> &algorithm) {
+        algorithm->update(data, length);
+    });
+}
+
+void MultiHasher::update(const QByteArray &data)
+{
+    update(data.constData(), data.size());
+}
+
+QVector<QByteArray> MultiHasher::finalize()
+{
+    m_hashValues.clear();
+    m_hashValues.reserve(count());
+    for (auto &algorithm : m_algorithms) {
+        m_hashValues.append(algorithm->finalize());
+    }
+
+    return m_hashValues;
+}
+
+void MultiHasher::reset()
+{
+    for (auto &algorithm : m_algorithms) {
+        algorithm->reset();
+    }
+}
+
+QVector<QByteArray> MultiHasher::hashValues() const
+{
+    return m_hashValues;
+}
+
+bool MultiHasher::useThreads(qint64 length) const
+{
+    return m_parallel && (m_algorithms.size() > 1) && (length >= MinParallelBlock);
+}
+
+} // namespace hashing
+} // namespace qkeeg
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef MULTIHASHER_HPP
+#define MULTIHASHER_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QIODevice>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+namespace qkeeg { namespace hashing {
+
+//! Feeds the same data to several hash algorithms in a single pass.
+class MultiHasher
+{
+    Q_GADGET
+
+public:
+    MultiHasher();
+    //! Takes ownership of the given algorithms. Throws a QString for null ones and for those that
+    //! aren't isIncremental(), as does addAlgorithm().
+    explicit MultiHasher(std::vector<std::unique_ptr<HashAlgorithm>> algorithms);
+    //! Creates the algorithms from the registry. Throws a QString for unknown names
+    //! and for algorithms that aren't isIncremental().
+    explicit MultiHasher(const QStringList &names);
+    ~MultiHasher();
+
+    void addAlgorithm(std::unique_ptr<HashAlgorithm> algorithm);
+    int count() const;
+    HashAlgorithm &algorithm(int index);
+    const HashAlgorithm &algorithm(int index) const;
+
+    //! Hash each block on a separate thread per algorithm.
+    bool isParallel() const;
+    void setParallel(bool parallel);
+
+    //! Compute all digests, in the order the algorithms were added.
+    QVector<QByteArray> computeHash(const QByteArray &data);
+    QVector<QByteArray> computeHash(const void *data, qint64 length);
+    //! Reads the device once, hashing the last block while the next one is read.
+    QVector<QByteArray> computeHash(QIODevice &instream);
+
+    void update(const void *data, qint64 length);
+    void update(const QByteArray &data);
+    QVector<QByteArray> finalize();
+    void reset();
+
+    //! Digests from the last finalize().
+    QVector<QByteArray> hashValues() const;
+
+private:
+    Q_DISABLE_COPY(MultiHasher)
+
+    bool useThreads(qint64 length) const;
+
+    /// Blocks smaller than this are not worth a thread hand-off.
+    static const qint64 MinParallelBlock = Q_INT64_C(16384);
+
+    std::vector<std::unique_ptr<HashAlgorithm>> m_algorithms;
+    QVector<QByteArray> m_hashValues;
+    bool m_parallel = true;
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // MULTIHASHER_HPP
@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "aphash32.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ APHash32::APHash32()
     initialize();
 }
 
+quint32 APHash32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<APHash32>::hash(data, length);
+}
+
 void APHash32::initialize()
 {
-    m_hash = m_seed;
+    m_state = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,22 +48,37 @@ quint32 APHash32::hashSize()
     return m_hashSize;
 }
 
-void APHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> APHash32::clone() const
+{
+    return std::make_unique<APHash32>(*this);
+}
+
+QString APHash32::name() const
+{
+    return QStringLiteral("aphash32");
+}
+
+void APHash32::hashCore(const void *data, qint64 offset, qint64 count)
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+    Core::updateState(m_state, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+}
 
-    for(qint64 i = 0; i < count; ++current, ++i)
-    {
-       m_hash ^= ((i & 0x01) == 0) ? (  (m_hash <<  7) ^ *current ^ (m_hash >> 3)) :
-                                     (~((m_hash << 11) ^ *current ^ (m_hash >> 5)));
-    }
+void APHash32::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint32>(Core::finalState(m_state), hash);
+}
+
+void APHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_state.hash);
+    writer.write(m_state.odd);
 }
 
-QByteArray APHash32::hashFinal()
+bool APHash32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_state.hash = reader.readUInt32();
+    m_state.odd = reader.readBoolean();
+    return true;
 }
 
 } // namespace noncryptographic
@@ -34,19 +34,62 @@ class APHash32 : public HashAlgorithm
 public:
     APHash32();
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    static quint32 hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT;
+
+    //! Non virtual core, see Hasher. The virtual interface below is an adapter over it.
+    struct Core
+    {
+        //! The odd and even bytes are mixed differently, so the position has to carry over
+        //! from one update to the next.
+        struct State
+        {
+            quint32 hash;
+            bool    odd;
+        };
+        using Result = quint32;
+
+        static State initialState() Q_DECL_NOEXCEPT
+        {
+            return State{ m_seed, false };
+        }
+
+        static void updateState(State &state, const quint8 *data, std::size_t length) Q_DECL_NOEXCEPT
+        {
+            quint32 hash = state.hash;
+            const std::size_t first = state.odd ? 1 : 0;
+            for (std::size_t i = 0; i < length; ++i) {
+                hash ^= (((i + first) & 0x01) == 0) ? (  (hash <<  7) ^ data[i] ^ (hash >> 3)) :
+                                                      (~((hash << 11) ^ data[i] ^ (hash >> 5)));
+            }
+
+            state.hash = hash;
+            state.odd = (((first + length) & 0x01) != 0);
+        }
+
+        static Result finalState(State state) Q_DECL_NOEXCEPT
+        {
+            return state.hash;
+        }
+    };
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
-    const quint32 m_seed = UINT32_C(0xAAAAAAAA);
-    quint32 m_hash;
+    static const quint32 m_seed = UINT32_C(0xAAAAAAAA);
+    Core::State m_state;
 };
 
 } // namespace noncryptographic
@@ -21,6 +21,8 @@
  */
 #include "bkdrhash32.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,6 +31,16 @@ BKDRHash32::BKDRHash32(const quint32 &seed) : HashAlgorithm(), m_seed(seed)
     initialize();
 }
 
+quint32 BKDRHash32::hash(const void *data, std::size_t length, quint32 seed) Q_DECL_NOEXCEPT
+{
+    BKDRHash32 algorithm(seed);
+    algorithm.hashCore(data, 0, static_cast<qint64>(length));
+
+    quint32 result;
+    algorithm.hashFinalInto(&result);
+    return result;
+}
+
 void BKDRHash32::initialize()
 {
     m_hash = m_seed;
@@ -40,7 +52,17 @@ quint32 BKDRHash32::hashSize()
     return m_hashSize;
 }
 
-void BKDRHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> BKDRHash32::clone() const
+{
+    return std::make_unique<BKDRHash32>(*this);
+}
+
+QString BKDRHash32::name() const
+{
+    return QStringLiteral("bkdrhash32");
+}
+
+void BKDRHash32::hashCore(const void *data, qint64 offset, qint64 count)
 {
     const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
 
@@ -50,11 +72,20 @@ void BKDRHash32::hashCore(const void *data, const qint64 &offset, const qint64 &
     }
 }
 
-QByteArray BKDRHash32::hashFinal()
+void BKDRHash32::hashFinalInto(void *hash)
+{
+    qkeeg::common::to_unaligned<quint32>(m_hash, hash);
+}
+
+void BKDRHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
+}
+
+bool BKDRHash32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    qkeeg::common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace noncryptographic
@@ -34,14 +34,21 @@ class BKDRHash32 : public HashAlgorithm
 public:
     BKDRHash32(const quint32 &seed = UINT32_C(131));
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    static quint32 hash(const void *data, std::size_t length, quint32 seed = UINT32_C(131)) Q_DECL_NOEXCEPT;
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "elfhash32.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ ElfHash32::ElfHash32()
     initialize();
 }
 
+quint32 ElfHash32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<ElfHash32>::hash(data, length);
+}
+
 void ElfHash32::initialize()
 {
-    m_hash = 0;
+    m_hash = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,29 +48,35 @@ quint32 ElfHash32::hashSize()
     return m_hashSize;
 }
 
-void ElfHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> ElfHash32::clone() const
+{
+    return std::make_unique<ElfHash32>(*this);
+}
+
+QString ElfHash32::name() const
 {
-    const quint8 *current = static_cast<const quint8*>(data) + offset;
+    return QStringLiteral("elfhash32");
+}
 
-    quint32 x = 0;
-    for (qint64 i = 0; i < count; ++current, ++i)
-    {
-        m_hash = (m_hash << 4) + *current;
-        x = m_hash & INT32_C(0xF0000000);
+void ElfHash32::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    Core::updateState(m_hash, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+}
 
-        if (x != 0) {
-            m_hash ^= (x >> 24);
-        }
+void ElfHash32::hashFinalInto(void *hash)
+{
+    qkeeg::common::to_unaligned<quint32>(m_hash, hash);
+}
 
-        m_hash &= ~x;
-    }
+void ElfHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
 }
 
-QByteArray ElfHash32::hashFinal()
+bool ElfHash32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    qkeeg::common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace noncryptographic
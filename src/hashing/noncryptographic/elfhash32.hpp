@@ -34,14 +34,51 @@ class ElfHash32 : public HashAlgorithm
 public:
     ElfHash32();
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    static quint32 hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT;
+
+    //! Non virtual core, see Hasher. The virtual interface below is an adapter over it.
+    struct Core
+    {
+        using State  = quint32;
+        using Result = quint32;
+
+        static State initialState() Q_DECL_NOEXCEPT
+        {
+            return 0;
+        }
+
+        static void updateState(State &hash, const quint8 *data, std::size_t length) Q_DECL_NOEXCEPT
+        {
+            for (std::size_t i = 0; i < length; ++i) {
+                hash = (hash << 4) + data[i];
+                const quint32 x = hash & UINT32_C(0xF0000000);
+                if (x != 0) {
+                    hash ^= (x >> 24);
+                }
+
+                hash &= ~x;
+            }
+        }
+
+        static Result finalState(State hash) Q_DECL_NOEXCEPT
+        {
+            return hash;
+        }
+    };
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
@@ -33,9 +33,43 @@ class Fnv1aHash32 : public Fnv1Hash32
 public:
     Fnv1aHash32();
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    static quint32 hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT;
+
+    //! Non virtual core, see Hasher. The virtual interface below is an adapter over it.
+    struct Core
+    {
+        using State  = quint32;
+        using Result = quint32;
+
+        static State initialState() Q_DECL_NOEXCEPT
+        {
+            return m_offsetBasis;
+        }
+
+        static void updateState(State &hash, const quint8 *data, std::size_t length) Q_DECL_NOEXCEPT
+        {
+            for (std::size_t i = 0; i < length; ++i) {
+                hash = (data[i] ^ hash) * m_fnvPrime;
+            }
+        }
+
+        static Result finalState(State hash) Q_DECL_NOEXCEPT
+        {
+            return hash;
+        }
+    };
+
     // HashAlgorithm interface
+public:
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
+
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    //! Hashes four messages at a time with independent multiply chains.
+    virtual void hashBatchCore(const void *const *ptrs, const std::size_t *lens, std::size_t n,
+                               quint8 *outDigests) override;
 };
 
 } // namespace noncryptographic
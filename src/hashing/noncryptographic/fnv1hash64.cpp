@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "fnv1hash64.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ Fnv1Hash64::Fnv1Hash64()
     initialize();
 }
 
+quint64 Fnv1Hash64::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<Fnv1Hash64>::hash(data, length);
+}
+
 void Fnv1Hash64::initialize()
 {
-    m_hash = m_offsetBasis;
+    m_hash = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,21 +48,35 @@ quint32 Fnv1Hash64::hashSize()
     return m_hashSize;
 }
 
-void Fnv1Hash64::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> Fnv1Hash64::clone() const
+{
+    return std::make_unique<Fnv1Hash64>(*this);
+}
+
+QString Fnv1Hash64::name() const
+{
+    return QStringLiteral("fnv1hash64");
+}
+
+void Fnv1Hash64::hashCore(const void *data, qint64 offset, qint64 count)
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+    Core::updateState(m_hash, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+}
 
-    for (qint64 i = 0; i < count; ++current, ++i)
-    {
-        m_hash = (m_fnvPrime * m_hash) ^ *current;
-    }
+void Fnv1Hash64::hashFinalInto(void *hash)
+{
+    qkeeg::common::to_unaligned<quint64>(m_hash, hash);
+}
+
+void Fnv1Hash64::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
 }
 
-QByteArray Fnv1Hash64::hashFinal()
+bool Fnv1Hash64::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    qkeeg::common::to_unaligned<quint64>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt64();
+    return true;
 }
 
 } // namespace noncryptographic
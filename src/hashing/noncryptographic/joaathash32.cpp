@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "joaathash32.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ JOAATHash32::JOAATHash32()
     initialize();
 }
 
+quint32 JOAATHash32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<JOAATHash32>::hash(data, length);
+}
+
 void JOAATHash32::initialize()
 {
-    m_hash = 0;
+    m_hash = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,28 +48,35 @@ quint32 JOAATHash32::hashSize()
     return m_hashSize;
 }
 
-void JOAATHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> JOAATHash32::clone() const
+{
+    return std::make_unique<JOAATHash32>(*this);
+}
+
+QString JOAATHash32::name() const
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+    return QStringLiteral("joaathash32");
+}
 
-    for (qint64 i = 0; i < count; ++current, ++i)
-    {
-        m_hash += *current;
-        m_hash += (m_hash << 10);
-        m_hash ^= (m_hash >> 6);
-    }
+void JOAATHash32::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    Core::updateState(m_hash, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
 }
 
-QByteArray JOAATHash32::hashFinal()
+void JOAATHash32::hashFinalInto(void *hash)
 {
-    m_hash += (m_hash << 3);
-    m_hash ^= (m_hash >> 11);
-    m_hash += (m_hash << 15);
+    common::to_unaligned<quint32>(Core::finalState(m_hash), hash);
+}
 
+void JOAATHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
+}
 
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+bool JOAATHash32::readState(io::BinaryReader &reader)
+{
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace noncryptographic
@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "pjwhash32.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ PJWHash32::PJWHash32() : HashAlgorithm()
     initialize();
 }
 
+quint32 PJWHash32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<PJWHash32>::hash(data, length);
+}
+
 void PJWHash32::initialize()
 {
-    m_hash = 0;
+    m_hash = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,26 +48,35 @@ quint32 PJWHash32::hashSize()
     return BitsInUnsignedInt;
 }
 
-void PJWHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> PJWHash32::clone() const
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
-    quint32 test = 0;
+    return std::make_unique<PJWHash32>(*this);
+}
 
-    for(qint64 i = 0; i < count; ++current, ++i)
-    {
-        m_hash = (m_hash << OneEighth) + *current;
+QString PJWHash32::name() const
+{
+    return QStringLiteral("pjwhash32");
+}
 
-        if((test = m_hash & HighBits) != 0) {
-            m_hash = ((m_hash ^ (test >> ThreeQuarters)) & (~HighBits));
-        }
-    }
+void PJWHash32::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    Core::updateState(m_hash, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+}
+
+void PJWHash32::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint32>(m_hash, hash);
+}
+
+void PJWHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
 }
 
-QByteArray PJWHash32::hashFinal()
+bool PJWHash32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace noncryptographic
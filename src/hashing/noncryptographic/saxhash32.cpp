@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "saxhash32.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ SaxHash32::SaxHash32() : HashAlgorithm()
     initialize();
 }
 
+quint32 SaxHash32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<SaxHash32>::hash(data, length);
+}
+
 void SaxHash32::initialize()
 {
-    m_hash = 0;
+    m_hash = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,21 +48,35 @@ quint32 SaxHash32::hashSize()
     return m_hashSize;
 }
 
-void SaxHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> SaxHash32::clone() const
+{
+    return std::make_unique<SaxHash32>(*this);
+}
+
+QString SaxHash32::name() const
+{
+    return QStringLiteral("saxhash32");
+}
+
+void SaxHash32::hashCore(const void *data, qint64 offset, qint64 count)
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+    Core::updateState(m_hash, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+}
 
-    for (qint64 i = 0; i < count; ++current, ++i)
-    {
-        m_hash ^= (m_hash << 5) + (m_hash >> 2) + *current;
-    }
+void SaxHash32::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint32>(m_hash, hash);
+}
+
+void SaxHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
 }
 
-QByteArray SaxHash32::hashFinal()
+bool SaxHash32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace noncryptographic
@@ -20,7 +20,10 @@
  * IN THE SOFTWARE.
  */
 #include "sdbmhash32.hpp"
+#include "../hasher.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -29,9 +32,14 @@ SDBMHash32::SDBMHash32() : HashAlgorithm()
     initialize();
 }
 
+quint32 SDBMHash32::hash(const void *data, std::size_t length) Q_DECL_NOEXCEPT
+{
+    return Hasher<SDBMHash32>::hash(data, length);
+}
+
 void SDBMHash32::initialize()
 {
-    m_hash = 0;
+    m_hash = Core::initialState();
     m_hashValue.clear();
 }
 
@@ -40,20 +48,35 @@ quint32 SDBMHash32::hashSize()
     return m_hashSize;
 }
 
-void SDBMHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> SDBMHash32::clone() const
+{
+    return std::make_unique<SDBMHash32>(*this);
+}
+
+QString SDBMHash32::name() const
+{
+    return QStringLiteral("sdbmhash32");
+}
+
+void SDBMHash32::hashCore(const void *data, qint64 offset, qint64 count)
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
+    Core::updateState(m_hash, reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+}
 
-    for (qint64 i = 0; i < count; ++current, ++i) {
-        m_hash = *current + (m_hash << 6) + (m_hash << 16) - m_hash;
-    }
+void SDBMHash32::hashFinalInto(void *hash)
+{
+    common::to_unaligned<quint32>(m_hash, hash);
+}
+
+void SDBMHash32::writeState(io::BinaryWriter &writer) const
+{
+    writer.write(m_hash);
 }
 
-QByteArray SDBMHash32::hashFinal()
+bool SDBMHash32::readState(io::BinaryReader &reader)
 {
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+    m_hash = reader.readUInt32();
+    return true;
 }
 
 } // namespace noncryptographic
@@ -21,6 +21,8 @@
  */
 #include "superfasthash32.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -31,7 +33,8 @@ SuperFastHash32::SuperFastHash32() : HashAlgorithm()
 
 void SuperFastHash32::initialize()
 {
-    m_hash = 0;
+    m_hash   = 0;
+    m_hashed = false;
     m_hashValue.clear();
 }
 
@@ -40,58 +43,50 @@ quint32 SuperFastHash32::hashSize()
     return m_hashSize;
 }
 
-void SuperFastHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> SuperFastHash32::clone() const
 {
-    const quint8 *current = reinterpret_cast<const quint8*>(data) + offset;
-    quint64 length = count;
-    quint32 temp;
-    qint32 rem = length & 3;
+    return std::make_unique<SuperFastHash32>(*this);
+}
 
-    if (m_hash == 0)
-        m_hash = static_cast<quint32>(length);
+QString SuperFastHash32::name() const
+{
+    return QStringLiteral("superfasthash32");
+}
 
-    length >>= 2;
+bool SuperFastHash32::isIncremental() const
+{
+    return false;
+}
 
-    for (; length > 0; length--)
-    {
-        m_hash  += common::from_unaligned<quint16>(current);
-        temp    = (common::from_unaligned<quint16>(current + 2) << 11) ^ m_hash;
-        m_hash  = (m_hash << 16) ^ temp;
-        current += 2 * sizeof(quint16);
-        m_hash  += m_hash >> 11;
+void SuperFastHash32::hashCore(const void *data, qint64 offset, qint64 count)
+{
+    // Not a streaming algorithm, and buffering the message instead would cost its whole size.
+    if (m_hashed) {
+        throw QString("SuperFastHash32 needs the whole message in a single update().");
     }
 
-    // Handle end cases
-    switch (rem)
-    {
-        case 3: m_hash += /*GET16BITS(current)*/ common::from_unaligned<quint16>(current);
-                m_hash ^= m_hash << 16;
-                m_hash ^= static_cast<qint8>(current[sizeof(quint16)]) << 18;
-                m_hash += m_hash >> 11;
-                break;
-        case 2: m_hash += /*GET16BITS(current)*/ common::from_unaligned<quint16>(current);
-                m_hash ^= m_hash << 11;
-                m_hash += m_hash >> 17;
-                break;
-        case 1: m_hash += *reinterpret_cast<const qint8*>(current);
-                m_hash ^= m_hash << 10;
-                m_hash += m_hash >> 1;
-    }
+    m_hash   = SuperFastHash32::hash(reinterpret_cast<const quint8*>(data) + offset, static_cast<std::size_t>(count));
+    m_hashed = true;
+}
+
+void SuperFastHash32::hashFinalInto(void *hash)
+{
+    const quint32 result = m_hashed ? m_hash : SuperFastHash32::hash(nullptr, 0);
+    common::to_unaligned<quint32>(result, hash);
 }
 
-QByteArray SuperFastHash32::hashFinal()
+void SuperFastHash32::writeState(io::BinaryWriter &writer) const
 {
-    // Force "avalanching" of final 127 bits
-    m_hash ^= m_hash << 3;
-    m_hash += m_hash >> 5;
-    m_hash ^= m_hash << 4;
-    m_hash += m_hash >> 17;
-    m_hash ^= m_hash << 25;
-    m_hash += m_hash >> 6;
+    writer.write(static_cast<quint8>(m_hashed ? 1 : 0));
+    writer.write(m_hash);
+}
 
-    QByteArray buffer(sizeof(m_hash), char(0));
-    common::to_unaligned<quint32>(m_hash, buffer.data());
-    return buffer;
+bool SuperFastHash32::readState(io::BinaryReader &reader)
+{
+    const quint8 hashed = reader.readByte();
+    m_hash   = reader.readUInt32();
+    m_hashed = (hashed != 0);
+    return hashed <= 1;
 }
 
 } // namespace noncryptographic
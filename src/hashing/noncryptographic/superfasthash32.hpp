@@ -23,6 +23,7 @@
 #define SUPERFASTHASH32_HPP
 
 #include "../hashalgorithm.hpp"
+#include "../../common/endian.hpp"
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
@@ -34,18 +35,80 @@ class SuperFastHash32 : public HashAlgorithm
 public:
     SuperFastHash32();
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    //! A non zero seed is mixed into the initial length based state.
+    //! Inline, so table lookups through StdHash don't pay for a call.
+    static quint32 hash(const void *data, std::size_t length, quint32 seed = 0) Q_DECL_NOEXCEPT
+    {
+        const quint8 *current = static_cast<const quint8*>(data);
+        quint32 hash = static_cast<quint32>(length) ^ seed;
+        quint32 temp;
+        qint32 rem = length & 3;
+
+        if (hash == 0)
+            hash = static_cast<quint32>(length);
+
+        length >>= 2;
+
+        for (; length > 0; length--)
+        {
+            hash    += common::from_unaligned<quint16>(current);
+            temp    = (common::from_unaligned<quint16>(current + 2) << 11) ^ hash;
+            hash    = (hash << 16) ^ temp;
+            current += 2 * sizeof(quint16);
+            hash    += hash >> 11;
+        }
+
+        // Handle end cases
+        switch (rem)
+        {
+            case 3: hash += /*GET16BITS(current)*/ common::from_unaligned<quint16>(current);
+                    hash ^= hash << 16;
+                    hash ^= static_cast<qint8>(current[sizeof(quint16)]) << 18;
+                    hash += hash >> 11;
+                    break;
+            case 2: hash += /*GET16BITS(current)*/ common::from_unaligned<quint16>(current);
+                    hash ^= hash << 11;
+                    hash += hash >> 17;
+                    break;
+            case 1: hash += *reinterpret_cast<const qint8*>(current);
+                    hash ^= hash << 10;
+                    hash += hash >> 1;
+        }
+
+        // Force "avalanching" of final 127 bits
+        hash ^= hash << 3;
+        hash += hash >> 5;
+        hash ^= hash << 4;
+        hash += hash >> 17;
+        hash ^= hash << 25;
+        hash += hash >> 6;
+
+        return hash;
+    }
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
+    //! The length of the message is its starting state, so the whole message has to come in a
+    //! single update(); a second one throws a QString.
+    virtual bool isIncremental() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
+
+    //! Digest of the message once its single update() came in.
     quint32 m_hash;
+    bool    m_hashed;
 };
 
 } // namespace noncryptographic
@@ -21,14 +21,12 @@
  */
 #include "xxhash32.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 #include <algorithm>
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
-#define GET32BITSLE(x) qkeeg::common::bytes_to_int_little<quint32>(x)
-
-#define ROTATELEFT(x,y) qkeeg::common::rotateLeft((x),(y))
-
 XxHash32::XxHash32(quint32 seed) : m_seed(seed)
 {
     initialize();
@@ -60,7 +58,17 @@ quint32 XxHash32::hashSize()
     return m_hashSize;
 }
 
-void XxHash32::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> XxHash32::clone() const
+{
+    return std::make_unique<XxHash32>(*this);
+}
+
+QString XxHash32::name() const
+{
+    return QStringLiteral("xxhash32");
+}
+
+void XxHash32::hashCore(const void *data, qint64 offset, qint64 count)
 {
     // byte-wise access
     const quint8* current = reinterpret_cast<const quint8*>(data) + offset;
@@ -110,57 +118,36 @@ void XxHash32::hashCore(const void *data, const qint64 &offset, const qint64 &co
     }
 }
 
-QByteArray XxHash32::hashFinal()
+void XxHash32::hashFinalInto(void *hash)
 {
-    quint32 result = static_cast<quint32>(m_totalLength);
-
-     // fold 128 bit state into one single 32 bit value
-     if (m_totalLength >= MaxBufferSize) {
-         result += ROTATELEFT(m_state[0],  1) +
-                   ROTATELEFT(m_state[1],  7) +
-                   ROTATELEFT(m_state[2], 12) +
-                   ROTATELEFT(m_state[3], 18);
-     }
-     else {
-         // internal state wasn't set in add(), therefore original seed is still stored in state2
-         result += m_state[2] + Prime5;
-     }
-
-     // process remaining bytes in temporary buffer
-     const quint8* data = m_buffer.data();
-     // point beyond last byte
-     const quint8* stop = data + m_bufferSize;
-
-     // at least 4 bytes left ? => eat 4 bytes per step
-     for (; data + 4 <= stop; data += 4) {
-         result = ROTATELEFT(result + GET32BITSLE(data) * Prime3, 17) * Prime4;
-     }
-
-     // take care of remaining 0..3 bytes, eat 1 byte per step
-     while (data != stop) {
-         result = ROTATELEFT(result + (*data++) * Prime5, 11) * Prime1;
-     }
-
-     // mix bits
-     result ^= result >> 15;
-     result *= Prime2;
-     result ^= result >> 13;
-     result *= Prime3;
-     result ^= result >> 16;
-
-     QByteArray buffer(sizeof(result), char(0));
-     common::to_unaligned<quint32>(result, buffer.data());
-     return buffer;
+    const quint32 result = finish(m_state.data(), static_cast<quint64>(m_totalLength), m_buffer.data(), m_bufferSize);
+    common::to_unaligned<quint32>(result, hash);
 }
 
-void XxHash32::process(const void *data, quint32 &state0, quint32 &state1, quint32 &state2, quint32 &state3)
+void XxHash32::writeState(io::BinaryWriter &writer) const
 {
-    const quint8 *block = reinterpret_cast<const quint8*>(data);
+    for (const auto &state : m_state) {
+        writer.write(state);
+    }
+    writer.write(static_cast<qint64>(m_totalLength));
+    writer.write(m_bufferSize);
+    writer.write(QByteArray::fromRawData(reinterpret_cast<const char*>(m_buffer.data()), static_cast<int>(m_bufferSize)));
+}
+
+bool XxHash32::readState(io::BinaryReader &reader)
+{
+    for (auto &state : m_state) {
+        state = reader.readUInt32();
+    }
+    m_totalLength = reader.readInt64();
+    m_bufferSize  = reader.readUInt32();
+    if (m_bufferSize >= MaxBufferSize) {
+        return false;
+    }
 
-    state0 = ROTATELEFT(state0 + GET32BITSLE(block   ) * Prime2, 13) * Prime1;
-    state1 = ROTATELEFT(state1 + GET32BITSLE(block+4 ) * Prime2, 13) * Prime1;
-    state2 = ROTATELEFT(state2 + GET32BITSLE(block+8 ) * Prime2, 13) * Prime1;
-    state3 = ROTATELEFT(state3 + GET32BITSLE(block+12) * Prime2, 13) * Prime1;
+    QByteArray buffer = reader.readBytes(static_cast<qint32>(m_bufferSize));
+    std::copy(buffer.constBegin(), buffer.constEnd(), m_buffer.begin());
+    return buffer.size() == static_cast<qint32>(m_bufferSize);
 }
 
 } // namespace noncryptographic
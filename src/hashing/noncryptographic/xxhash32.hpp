@@ -23,6 +23,7 @@
 #define XXHASH32_HPP
 
 #include "../hashalgorithm.hpp"
+#include "../../common/endian.hpp"
 #include <array>
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
@@ -35,14 +36,37 @@ public:
     XxHash32(quint32 seed = 0);
     virtual ~XxHash32();
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    //! Inline, so table lookups through StdHash don't pay for a call or an object.
+    static quint32 hash(const void *data, std::size_t length, quint32 seed = 0) Q_DECL_NOEXCEPT
+    {
+        const quint8* current = static_cast<const quint8*>(data);
+        const quint8* stop    = current + length;
+
+        quint32 state[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+        if (length >= static_cast<std::size_t>(MaxBufferSize)) {
+            const quint8* stopBlock = stop - MaxBufferSize;
+            while (current <= stopBlock) {
+                process(current, state[0], state[1], state[2], state[3]);
+                current += 16;
+            }
+        }
+
+        return finish(state, length, current, static_cast<std::size_t>(stop - current));
+    }
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
     static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
@@ -65,7 +89,55 @@ private:
     quint32  m_seed;
 
     /// process a block of 4x4 bytes, this is the main part of the XXHash32 algorithm
-    void process(const void* data, quint32 &state0, quint32 &state1, quint32 &state2, quint32 &state3);
+    static void process(const void* data, quint32 &state0, quint32 &state1, quint32 &state2, quint32 &state3) Q_DECL_NOEXCEPT
+    {
+        const quint8 *block = reinterpret_cast<const quint8*>(data);
+
+        state0 = common::rotateLeft(state0 + common::bytes_to_int_little<quint32>(block   ) * Prime2, 13) * Prime1;
+        state1 = common::rotateLeft(state1 + common::bytes_to_int_little<quint32>(block+4 ) * Prime2, 13) * Prime1;
+        state2 = common::rotateLeft(state2 + common::bytes_to_int_little<quint32>(block+8 ) * Prime2, 13) * Prime1;
+        state3 = common::rotateLeft(state3 + common::bytes_to_int_little<quint32>(block+12) * Prime2, 13) * Prime1;
+    }
+
+    /// fold the state and the unprocessed tail (less than 16 bytes) into the final value
+    static quint32 finish(const quint32 *state, quint64 totalLength, const quint8 *data, std::size_t length) Q_DECL_NOEXCEPT
+    {
+        quint32 result = static_cast<quint32>(totalLength);
+
+        // fold 128 bit state into one single 32 bit value
+        if (totalLength >= static_cast<quint64>(MaxBufferSize)) {
+            result += common::rotateLeft(state[0],  1) +
+                      common::rotateLeft(state[1],  7) +
+                      common::rotateLeft(state[2], 12) +
+                      common::rotateLeft(state[3], 18);
+        }
+        else {
+            // internal state wasn't set in add(), therefore original seed is still stored in state2
+            result += state[2] + Prime5;
+        }
+
+        // point beyond last byte
+        const quint8* stop = data + length;
+
+        // at least 4 bytes left ? => eat 4 bytes per step
+        for (; data + 4 <= stop; data += 4) {
+            result = common::rotateLeft(result + common::bytes_to_int_little<quint32>(data) * Prime3, 17) * Prime4;
+        }
+
+        // take care of remaining 0..3 bytes, eat 1 byte per step
+        while (data != stop) {
+            result = common::rotateLeft(result + (*data++) * Prime5, 11) * Prime1;
+        }
+
+        // mix bits
+        result ^= result >> 15;
+        result *= Prime2;
+        result ^= result >> 13;
+        result *= Prime3;
+        result ^= result >> 16;
+
+        return result;
+    }
 };
 
 } // namespace noncryptographic
@@ -21,16 +21,12 @@
  */
 #include "xxhash64.hpp"
 #include "../../common/endian.hpp"
+#include "../../io/binaryreader.hpp"
+#include "../../io/binarywriter.hpp"
 #include <algorithm>
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
 
-#define GET32BITSLE(x) qkeeg::common::bytes_to_int_little<quint32>(x)
-
-#define GET64BITSLE(x) qkeeg::common::bytes_to_int_little<quint64>(x)
-
-#define ROTATELEFT(x,y) qkeeg::common::rotateLeft((x),(y))
-
 XxHash64::XxHash64(quint64 seed) : m_seed(seed)
 {
     initialize();
@@ -53,7 +49,17 @@ quint32 XxHash64::hashSize()
     return m_hashSize;
 }
 
-void XxHash64::hashCore(const void *data, const qint64 &offset, const qint64 &count)
+std::unique_ptr<HashAlgorithm> XxHash64::clone() const
+{
+    return std::make_unique<XxHash64>(*this);
+}
+
+QString XxHash64::name() const
+{
+    return QStringLiteral("xxhash64");
+}
+
+void XxHash64::hashCore(const void *data, qint64 offset, qint64 count)
 {
     qint64 length = count;
     m_totalLength += length;
@@ -104,73 +110,36 @@ void XxHash64::hashCore(const void *data, const qint64 &offset, const qint64 &co
     }
 }
 
-QByteArray XxHash64::hashFinal()
+void XxHash64::hashFinalInto(void *hash)
 {
-    // fold 256 bit state into one single 64 bit value
-    quint64 result;
-    if (m_totalLength >= MaxBufferSize)
-    {
-        result = ROTATELEFT(m_state[0],  1) +
-                 ROTATELEFT(m_state[1],  7) +
-                 ROTATELEFT(m_state[2], 12) +
-                 ROTATELEFT(m_state[3], 18);
-        result = (result ^ processSingle(0, m_state[0])) * Prime1 + Prime4;
-        result = (result ^ processSingle(0, m_state[1])) * Prime1 + Prime4;
-        result = (result ^ processSingle(0, m_state[2])) * Prime1 + Prime4;
-        result = (result ^ processSingle(0, m_state[3])) * Prime1 + Prime4;
-    }
-    else
-    {
-        // internal state wasn't set in add(), therefore original seed is still stored in state2
-        result = m_state[2] + Prime5;
-    }
-
-    result += m_totalLength;
-
-    // process remaining bytes in temporary buffer
-    const quint8* data = m_buffer.data();
-    // point beyond last byte
-    const quint8* stop = data + m_bufferSize;
-
-    // at least 8 bytes left ? => eat 8 bytes per step
-    for (; data + 8 <= stop; data += 8)
-        result = ROTATELEFT(result ^ processSingle(0, GET64BITSLE(data)), 27) * Prime1 + Prime4;
-
-    // 4 bytes left ? => eat those
-    if (data + 4 <= stop)
-    {
-        result = ROTATELEFT(result ^ GET32BITSLE(data) * Prime1, 23) * Prime2 + Prime3;
-        data  += 4;
-    }
-
-    // take care of remaining 0..3 bytes, eat 1 byte per step
-    while (data != stop)
-        result = ROTATELEFT(result ^ (*data++) * Prime5, 11) * Prime1;
-
-    // mix bits
-    result ^= result >> 33;
-    result *= Prime2;
-    result ^= result >> 29;
-    result *= Prime3;
-    result ^= result >> 32;
-
-    QByteArray buffer(sizeof(result), char(0));
-    common::to_unaligned<quint64>(result, buffer.data());
-    return buffer;
+    const quint64 result = finish(m_state.data(), static_cast<quint64>(m_totalLength), m_buffer.data(), m_bufferSize);
+    common::to_unaligned<quint64>(result, hash);
 }
 
-quint64 XxHash64::processSingle(const quint64 &previous, const quint64 &input)
+void XxHash64::writeState(io::BinaryWriter &writer) const
 {
-    return ROTATELEFT(previous + input * Prime2, 31) * Prime1;
+    for (const auto &state : m_state) {
+        writer.write(state);
+    }
+    writer.write(static_cast<qint64>(m_totalLength));
+    writer.write(m_bufferSize);
+    writer.write(QByteArray::fromRawData(reinterpret_cast<const char*>(m_buffer.data()), static_cast<int>(m_bufferSize)));
 }
 
-void XxHash64::process(const void *data, quint64 &state0, quint64 &state1, quint64 &state2, quint64 &state3)
+bool XxHash64::readState(io::BinaryReader &reader)
 {
-    const quint8 *block = reinterpret_cast<const quint8*>(data);
-    state0 = processSingle(state0, GET64BITSLE(block + (sizeof(quint8) * 0)));
-    state1 = processSingle(state1, GET64BITSLE(block + (sizeof(quint8) * 1)));
-    state2 = processSingle(state2, GET64BITSLE(block + (sizeof(quint8) * 2)));
-    state3 = processSingle(state3, GET64BITSLE(block + (sizeof(quint8) * 3)));
+    for (auto &state : m_state) {
+        state = reader.readUInt64();
+    }
+    m_totalLength = reader.readInt64();
+    m_bufferSize  = reader.readUInt32();
+    if (m_bufferSize >= MaxBufferSize) {
+        return false;
+    }
+
+    QByteArray buffer = reader.readBytes(static_cast<qint32>(m_bufferSize));
+    std::copy(buffer.constBegin(), buffer.constEnd(), m_buffer.begin());
+    return buffer.size() == static_cast<qint32>(m_bufferSize);
 }
 
 } // namespace noncryptographic
@@ -23,6 +23,7 @@
 #define XXHASH64_HPP
 
 #include "../hashalgorithm.hpp"
+#include "../../common/endian.hpp"
 #include <array>
 
 namespace qkeeg { namespace hashing { namespace noncryptographic {
@@ -34,17 +35,40 @@ class XxHash64 : public HashAlgorithm
 public:
     XxHash64(quint64 seed = 0);
 
+    //! One-shot hash of a buffer. No heap allocation, no exceptions, reentrant.
+    //! Inline, so table lookups through StdHash don't pay for a call or an object.
+    static quint64 hash(const void *data, std::size_t length, quint64 seed = 0) Q_DECL_NOEXCEPT
+    {
+        const quint8* current = static_cast<const quint8*>(data);
+        const quint8* stop    = current + length;
+
+        quint64 state[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+        if (length >= static_cast<std::size_t>(MaxBufferSize)) {
+            const quint8* stopBlock = stop - MaxBufferSize;
+            while (current <= stopBlock) {
+                process(current, state[0], state[1], state[2], state[3]);
+                current += 32;
+            }
+        }
+
+        return finish(state, length, current, static_cast<std::size_t>(stop - current));
+    }
+
     // HashAlgorithm interface
 public:
     virtual void initialize() override;
     virtual quint32 hashSize() override;
+    virtual std::unique_ptr<HashAlgorithm> clone() const override;
+    virtual QString name() const override;
 
 protected:
-    virtual void hashCore(const void *data, const qint64 &offset, const qint64 &count) override;
-    virtual QByteArray hashFinal() override;
+    virtual void hashCore(const void *data, qint64 offset, qint64 count) override;
+    virtual void hashFinalInto(void *hash) override;
+    virtual void writeState(io::BinaryWriter &writer) const override;
+    virtual bool readState(io::BinaryReader &reader) override;
 
 private:
-    static const quint32 m_hashSize = std::numeric_limits<quint32>::digits;
+    static const quint32 m_hashSize = std::numeric_limits<quint64>::digits;
 
     /// magic constants
     static const quint64 Prime1 = UINT64_C(11400714785074694791);
@@ -63,10 +87,72 @@ private:
     quint64  m_seed;
 
     /// process a single 64 bit value
-    quint64 processSingle(const quint64 &previous, const quint64 &input);
+    static quint64 processSingle(quint64 previous, quint64 input) Q_DECL_NOEXCEPT
+    {
+        return common::rotateLeft(previous + input * Prime2, 31) * Prime1;
+    }
 
     /// process a block of 4x8 bytes, this is the main part of the XXHash64 algorithm
-    void process(const void* data, quint64 &state0, quint64 &state1, quint64 &state2, quint64 &state3);
+    static void process(const void* data, quint64 &state0, quint64 &state1, quint64 &state2, quint64 &state3) Q_DECL_NOEXCEPT
+    {
+        const quint8 *block = reinterpret_cast<const quint8*>(data);
+        state0 = processSingle(state0, common::bytes_to_int_little<quint64>(block + (sizeof(quint8) * 0)));
+        state1 = processSingle(state1, common::bytes_to_int_little<quint64>(block + (sizeof(quint8) * 1)));
+        state2 = processSingle(state2, common::bytes_to_int_little<quint64>(block + (sizeof(quint8) * 2)));
+        state3 = processSingle(state3, common::bytes_to_int_little<quint64>(block + (sizeof(quint8) * 3)));
+    }
+
+    /// fold the state and the unprocessed tail (less than 32 bytes) into the final value
+    static quint64 finish(const quint64 *state, quint64 totalLength, const quint8 *data, std::size_t length) Q_DECL_NOEXCEPT
+    {
+        // fold 256 bit state into one single 64 bit value
+        quint64 result;
+        if (totalLength >= static_cast<quint64>(MaxBufferSize))
+        {
+            result = common::rotateLeft(state[0],  1) +
+                     common::rotateLeft(state[1],  7) +
+                     common::rotateLeft(state[2], 12) +
+                     common::rotateLeft(state[3], 18);
+            result = (result ^ processSingle(0, state[0])) * Prime1 + Prime4;
+            result = (result ^ processSingle(0, state[1])) * Prime1 + Prime4;
+            result = (result ^ processSingle(0, state[2])) * Prime1 + Prime4;
+            result = (result ^ processSingle(0, state[3])) * Prime1 + Prime4;
+        }
+        else
+        {
+            // internal state wasn't set in add(), therefore original seed is still stored in state2
+            result = state[2] + Prime5;
+        }
+
+        result += totalLength;
+
+        // point beyond last byte
+        const quint8* stop = data + length;
+
+        // at least 8 bytes left ? => eat 8 bytes per step
+        for (; data + 8 <= stop; data += 8)
+            result = common::rotateLeft(result ^ processSingle(0, common::bytes_to_int_little<quint64>(data)), 27) * Prime1 + Prime4;
+
+        // 4 bytes left ? => eat those
+        if (data + 4 <= stop)
+        {
+            result = common::rotateLeft(result ^ common::bytes_to_int_little<quint32>(data) * Prime1, 23) * Prime2 + Prime3;
+            data  += 4;
+        }
+
+        // take care of remaining 0..3 bytes, eat 1 byte per step
+        while (data != stop)
+            result = common::rotateLeft(result ^ (*data++) * Prime5, 11) * Prime1;
+
+        // mix bits
+        result ^= result >> 33;
+        result *= Prime2;
+        result ^= result >> 29;
+        result *= Prime3;
+        result ^= result >> 32;
+
+        return result;
+    }
 };
 
 } // namespace noncryptographic
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef STDHASH_HPP
+#define STDHASH_HPP
+
+#include "noncryptographic/superfasthash32.hpp"
+#include "noncryptographic/xxhash32.hpp"
+#include "noncryptographic/xxhash64.hpp"
+#include "noncryptographic/fnv1ahash64.hpp"
+#include <QtGlobal>
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QString>
+#include <QStringView>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+namespace qkeeg { namespace hashing {
+
+//! Seed shared by all StdHash instances in this process. Random, unless the environment
+//! variable QKEEG_HASH_SEED is set, which makes runs reproducible.
+inline quint64 processHashSeed() Q_DECL_NOEXCEPT
+{
+    static const quint64 seed = qEnvironmentVariableIsSet("QKEEG_HASH_SEED")
+            ? qgetenv("QKEEG_HASH_SEED").toULongLong(nullptr, 0)
+            : QRandomGenerator::system()->generate64();
+    return seed;
+}
+
+//! Hash functor for QHash and std::unordered_map backed by a seeded one-shot hash, e.g.
+//! StdHash<noncryptographic::XxHash64>. Algo needs a static hash(data, length, seed).
+template<class Algo>
+class StdHash
+{
+public:
+    using result_type = std::size_t;
+
+    StdHash() Q_DECL_NOEXCEPT : m_seed(processHashSeed()) { }
+    explicit StdHash(quint64 seed) Q_DECL_NOEXCEPT : m_seed(seed) { }
+
+    //! Raw bytes.
+    std::size_t operator()(const void *data, std::size_t length) const Q_DECL_NOEXCEPT
+    {
+        return invoke(&Algo::hash, data, length);
+    }
+
+    //! Integral and enum keys, hashed by value.
+    template<class T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+    std::size_t operator()(T key) const Q_DECL_NOEXCEPT
+    {
+        return (*this)(&key, sizeof(key));
+    }
+
+    std::size_t operator()(const QByteArray &key) const Q_DECL_NOEXCEPT
+    {
+        return (*this)(key.constData(), static_cast<std::size_t>(key.size()));
+    }
+
+    //! Text is hashed as UTF-16 code units, no conversion.
+    std::size_t operator()(QStringView key) const Q_DECL_NOEXCEPT
+    {
+        return (*this)(key.utf16(), static_cast<std::size_t>(key.size()) * sizeof(char16_t));
+    }
+
+    std::size_t operator()(const QString &key) const Q_DECL_NOEXCEPT
+    {
+        return (*this)(QStringView(key));
+    }
+
+    std::size_t operator()(const std::string &key) const Q_DECL_NOEXCEPT
+    {
+        return (*this)(key.data(), key.size());
+    }
+
+    quint64 seed() const Q_DECL_NOEXCEPT
+    {
+        return m_seed;
+    }
+
+private:
+    template<class Result, class Seed>
+    std::size_t invoke(Result (*hash)(const void *, std::size_t, Seed),
+                       const void *data, std::size_t length) const Q_DECL_NOEXCEPT
+    {
+        return static_cast<std::size_t>(hash(data, length, static_cast<Seed>(m_seed)));
+    }
+
+    quint64 m_seed;
+};
+
+//! Body for a qHash() overload, e.g.
+//! inline uint qHash(const Key &key, uint seed) { return qHashWith<XxHash64>(key.id, seed); }
+//! QHash's own seed is combined with processHashSeed().
+template<class Algo, class Key>
+inline uint qHashWith(const Key &key, uint seed = 0) Q_DECL_NOEXCEPT
+{
+    const quint64 value = StdHash<Algo>(processHashSeed() ^ seed)(key);
+    return static_cast<uint>(value ^ (value >> 32));
+}
+
+using StdXxHash32        = StdHash<noncryptographic::XxHash32>;
+using StdXxHash64        = StdHash<noncryptographic::XxHash64>;
+using StdFnv1aHash64     = StdHash<noncryptographic::Fnv1aHash64>;
+using StdSuperFastHash32 = StdHash<noncryptographic::SuperFastHash32>;
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // STDHASH_HPP
@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "treehasher.hpp"
+#include "hashalgorithmregistry.hpp"
+#include "../common/workstealingpool.hpp"
+#include "../io/bufferpool.hpp"
+#include "../io/positionalreader.hpp"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace qkeeg { namespace hashing {
+
+namespace {
+
+/// Most files hashed by one batch task.
+const int MaxBatchFiles = 256;
+
+struct Node;
+
+/// A file or directory, in the sorted listing of its parent.
+struct Entry
+{
+    QString path;
+    qint64 size = 0;
+    //! Set for directories.
+    std::unique_ptr<Node> directory;
+    QByteArray digest;
+    bool ok = false;
+    //! Set once the digest is in. Guarded by the run's mutex, like Node::listed.
+    bool done = false;
+};
+
+struct Node
+{
+    std::vector<Entry> entries;
+    bool listed = false;
+};
+
+/// The parts of a file split into ranges, the last range to finish combines them.
+struct RangeJob
+{
+    explicit RangeJob(int count) : parts(static_cast<std::size_t>(count)), remaining(count), failed(false) { }
+
+    std::vector<std::unique_ptr<HashAlgorithm>> parts;
+    std::atomic<int> remaining;
+    std::atomic<bool> failed;
+};
+
+} // anonymous namespace
+
+struct TreeHasher::Run
+{
+    Run(const TreeHasher &owner) :
+        prototype(*owner.m_algorithm), smallFileSize(owner.m_smallFileSize), batchSize(owner.m_batchSize),
+        rangeSize(owner.m_rangeSize), splitFiles(owner.m_algorithm->isCombinable()), pool(owner.m_threadCount)
+    {
+
+    }
+
+    void list(Node *node, const QString &path);
+    void hashBatch(const std::vector<Entry*> &batch);
+    void hashFile(Entry *entry);
+    void splitFile(Entry *entry);
+    void hashRange(Entry *entry, const std::shared_ptr<io::PositionalReader> &reader,
+                   const std::shared_ptr<RangeJob> &job, int index);
+    QByteArray hashOne(HashAlgorithm &algorithm, const QString &path);
+    void waitFor(const bool &condition);
+
+    const HashAlgorithm &prototype;
+    const qint64 smallFileSize;
+    const qint64 batchSize;
+    const qint64 rangeSize;
+    const bool splitFiles;
+
+    QMutex mutex;
+    QWaitCondition changed;
+
+    std::atomic<qint64> files{0};
+    std::atomic<qint64> directories{0};
+    std::atomic<qint64> bytes{0};
+    std::atomic<qint64> errors{0};
+
+    // Last, so it is stopped before the rest goes away.
+    common::WorkStealingPool pool;
+};
+
+void TreeHasher::Run::list(Node *node, const QString &path)
+{
+    const QDir directory(path);
+    if (!QFileInfo(path).isReadable()) {
+        ++errors;
+    }
+
+    const QFileInfoList infos = directory.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot |
+                                                        QDir::Hidden | QDir::System | QDir::NoSymLinks, QDir::Name);
+    node->entries.resize(static_cast<std::size_t>(infos.size()));
+
+    // Everything is queued only after the node is published, nothing here touches it after that.
+    std::vector<common::WorkStealingPool::Task> tasks;
+    std::vector<Entry*> batch;
+    qint64 batchBytes = 0;
+    const auto flushBatch = [&]() {
+        if (!batch.empty()) {
+            tasks.push_back([this, batch]() { hashBatch(batch); });
+            batch.clear();
+            batchBytes = 0;
+        }
+    };
+
+    for (int i = 0; i < infos.size(); ++i) {
+        const QFileInfo &info = infos.at(i);
+        Entry *entry = &node->entries[static_cast<std::size_t>(i)];
+        entry->path = info.filePath();
+
+        if (info.isDir()) {
+            entry->directory = std::make_unique<Node>();
+            Node *child = entry->directory.get();
+            const QString childPath = entry->path;
+            tasks.push_back([this, child, childPath]() { list(child, childPath); });
+            ++directories;
+            continue;
+        }
+
+        entry->size = info.size();
+        if (entry->size <= smallFileSize) {
+            batch.push_back(entry);
+            batchBytes += entry->size;
+            if ((batchBytes >= batchSize) || (static_cast<int>(batch.size()) >= MaxBatchFiles)) {
+                flushBatch();
+            }
+        }
+        else if (splitFiles && (entry->size >= (2 * rangeSize))) {
+            tasks.push_back([this, entry]() { splitFile(entry); });
+        }
+        else {
+            tasks.push_back([this, entry]() { hashFile(entry); });
+        }
+    }
+    flushBatch();
+
+    {
+        QMutexLocker locker(&mutex);
+        node->listed = true;
+        changed.wakeAll();
+    }
+
+    for (auto &task : tasks) {
+        pool.submit(std::move(task));
+    }
+}
+
+QByteArray TreeHasher::Run::hashOne(HashAlgorithm &algorithm, const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    return algorithm.computeHash(file);
+}
+
+void TreeHasher::Run::hashBatch(const std::vector<Entry*> &batch)
+{
+    std::unique_ptr<HashAlgorithm> algorithm = prototype.clone();
+    std::vector<QByteArray> digests;
+    digests.reserve(batch.size());
+    for (Entry *entry : batch) {
+        digests.push_back(hashOne(*algorithm, entry->path));
+    }
+
+    // One lock for the whole batch. Once done is set the entry may be gone, so it is set last.
+    QMutexLocker locker(&mutex);
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        Entry *entry = batch[i];
+        entry->ok = !digests[i].isEmpty();
+        entry->digest = digests[i];
+        bytes += entry->size;
+        ++files;
+        if (!entry->ok) {
+            ++errors;
+        }
+        entry->done = true;
+    }
+    changed.wakeAll();
+}
+
+void TreeHasher::Run::hashFile(Entry *entry)
+{
+    hashBatch(std::vector<Entry*>(1, entry));
+}
+
+void TreeHasher::Run::splitFile(Entry *entry)
+{
+    auto reader = std::make_shared<io::PositionalReader>(entry->path);
+    if (!reader->isOpen()) {
+        hashFile(entry);
+        return;
+    }
+
+    const int count = static_cast<int>((reader->size() + rangeSize - 1) / rangeSize);
+    if (count < 2) {
+        hashFile(entry);
+        return;
+    }
+
+    auto job = std::make_shared<RangeJob>(count);
+    for (int i = 0; i < count; ++i) {
+        pool.submit([this, entry, reader, job, i]() { hashRange(entry, reader, job, i); });
+    }
+}
+
+void TreeHasher::Run::hashRange(Entry *entry, const std::shared_ptr<io::PositionalReader> &reader,
+                                const std::shared_ptr<RangeJob> &job, int index)
+{
+    std::unique_ptr<HashAlgorithm> part = prototype.clone();
+    part->reset();
+
+    io::BufferPool::Buffer buffer = HashAlgorithm::bufferPool().acquire();
+    const qint64 size = reader->size();
+    qint64 offset = static_cast<qint64>(index) * rangeSize;
+    const qint64 end = qMin(offset + rangeSize, size);
+    while (offset < end) {
+        const qint64 numBytesRead = reader->read(buffer.data(), qMin(end - offset, buffer.size()), offset);
+        if (numBytesRead <= 0) {
+            job->failed = true;
+            break;
+        }
+
+        part->update(buffer.data(), numBytesRead);
+        offset += numBytesRead;
+    }
+
+    job->parts[static_cast<std::size_t>(index)] = std::move(part);
+    if (--job->remaining != 0) {
+        return;
+    }
+
+    // Last range in: join the parts in file order.
+    QByteArray digest;
+    if (!job->failed) {
+        HashAlgorithm &whole = *job->parts.front();
+        for (std::size_t i = 1; i < job->parts.size(); ++i) {
+            whole.combine(*job->parts[i]);
+        }
+        digest = whole.finalize();
+    }
+
+    QMutexLocker locker(&mutex);
+    entry->ok = !digest.isEmpty();
+    entry->digest = digest;
+    entry->size = size;
+    bytes += size;
+    ++files;
+    if (!entry->ok) {
+        ++errors;
+    }
+    entry->done = true;
+    changed.wakeAll();
+}
+
+void TreeHasher::Run::waitFor(const bool &condition)
+{
+    QMutexLocker locker(&mutex);
+    while (!condition) {
+        changed.wait(&mutex);
+    }
+}
+
+double TreeHasher::Statistics::bytesPerSecond() const
+{
+    return (elapsedMs > 0) ? ((static_cast<double>(bytes) * 1000.0) / static_cast<double>(elapsedMs)) : 0.0;
+}
+
+double TreeHasher::Statistics::filesPerSecond() const
+{
+    return (elapsedMs > 0) ? ((static_cast<double>(files) * 1000.0) / static_cast<double>(elapsedMs)) : 0.0;
+}
+
+TreeHasher::TreeHasher(const HashAlgorithm &algorithm) :
+    m_algorithm(algorithm.clone())
+{
+    m_algorithm->requireIncremental();
+    m_algorithm->setProgressCallback(nullptr);
+}
+
+TreeHasher::TreeHasher(const QString &algorithm)
+{
+    m_algorithm = HashAlgorithmRegistry::instance().create(algorithm);
+    if (!m_algorithm) {
+        throw QString("Unknown hash algorithm: %1").arg(algorithm);
+    }
+    m_algorithm->requireIncremental();
+}
+
+TreeHasher::~TreeHasher()
+{
+
+}
+
+int TreeHasher::threadCount() const
+{
+    return m_threadCount;
+}
+
+void TreeHasher::setThreadCount(int count)
+{
+    m_threadCount = qMax(count, 0);
+}
+
+qint64 TreeHasher::smallFileSize() const
+{
+    return m_smallFileSize;
+}
+
+void TreeHasher::setSmallFileSize(qint64 size)
+{
+    m_smallFileSize = qMax(size, Q_INT64_C(0));
+}
+
+qint64 TreeHasher::batchSize() const
+{
+    return m_batchSize;
+}
+
+void TreeHasher::setBatchSize(qint64 size)
+{
+    m_batchSize = qMax(size, Q_INT64_C(1));
+}
+
+qint64 TreeHasher::rangeSize() const
+{
+    return m_rangeSize;
+}
+
+void TreeHasher::setRangeSize(qint64 size)
+{
+    m_rangeSize = qMax(size, Q_INT64_C(1));
+}
+
+TreeHasher::Statistics TreeHasher::hashTree(const QString &rootPath, const ResultCallback &callback)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Run run(*this);
+
+    // A made up parent holding the root, so a single file and a tree are walked the same way.
+    Node top;
+    top.entries.resize(1);
+    Entry &root = top.entries.front();
+    root.path = rootPath;
+    if (QFileInfo(rootPath).isDir()) {
+        root.directory = std::make_unique<Node>();
+        Node *child = root.directory.get();
+        ++run.directories;
+        run.pool.submit([&run, child, rootPath]() { run.list(child, rootPath); });
+    }
+    else {
+        root.size = QFileInfo(rootPath).size();
+        Entry *entry = &root;
+        run.pool.submit([&run, entry]() { run.hashFile(entry); });
+    }
+    top.listed = true;
+
+    // Depth first over the sorted listings, waiting for each piece as it is reached.
+    std::vector<std::pair<Node*, std::size_t>> stack;
+    stack.emplace_back(&top, 0);
+    while (!stack.empty()) {
+        Node *node = stack.back().first;
+        run.waitFor(node->listed);
+
+        const std::size_t index = stack.back().second++;
+        if (index == node->entries.size()) {
+            stack.pop_back();
+            if (!stack.empty()) {
+                // Everything below is reported, release it.
+                stack.back().first->entries[stack.back().second - 1].directory.reset();
+            }
+            continue;
+        }
+
+        Entry &entry = node->entries[index];
+        if (entry.directory) {
+            stack.emplace_back(entry.directory.get(), 0);
+            continue;
+        }
+
+        run.waitFor(entry.done);
+        if (callback) {
+            callback(FileDigest{ entry.path, entry.size, entry.digest, entry.ok });
+        }
+        entry.digest.clear();
+    }
+
+    run.pool.waitForDone();
+
+    Statistics statistics;
+    statistics.files       = run.files;
+    statistics.directories = run.directories;
+    statistics.bytes       = run.bytes;
+    statistics.errors      = run.errors;
+    statistics.elapsedMs   = timer.elapsed();
+    return statistics;
+}
+
+} // namespace hashing
+} // namespace qkeeg
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef TREEHASHER_HPP
+#define TREEHASHER_HPP
+
+#include "hashalgorithm.hpp"
+#include <QByteArray>
+#include <QString>
+#include <functional>
+#include <memory>
+
+namespace qkeeg { namespace hashing {
+
+//! Hashes every file below a directory on a work stealing pool. Directories are listed
+//! concurrently, small files are hashed in batches to keep the per task overhead down, and large
+//! files are split into ranges hashed in parallel when the algorithm can combine them (crc32,
+//! crc64, adler32). Results are handed back in path order, the same for every run.
+class TreeHasher
+{
+    Q_GADGET
+
+public:
+    //! Result for one file. ok is false, and digest empty, if it couldn't be read.
+    struct FileDigest
+    {
+        QString path;
+        qint64 size;
+        QByteArray digest;
+        bool ok;
+    };
+
+    //! Totals of one hashTree() run.
+    struct Statistics
+    {
+        qint64 files       = 0;
+        qint64 directories = 0;
+        qint64 bytes       = 0;
+        qint64 errors      = 0;
+        qint64 elapsedMs   = 0;
+
+        double bytesPerSecond() const;
+        double filesPerSecond() const;
+    };
+
+    //! Called on the thread running hashTree(), once per file, in path order.
+    using ResultCallback = std::function<void(const FileDigest &)>;
+
+    //! Every file is hashed with a copy of algorithm. Throws a QString if it isn't isIncremental().
+    explicit TreeHasher(const HashAlgorithm &algorithm);
+    //! Creates the algorithm from the registry. Throws a QString for unknown names
+    //! and for algorithms that aren't isIncremental().
+    explicit TreeHasher(const QString &algorithm);
+    ~TreeHasher();
+
+    //! Worker threads, 0 uses QThread::idealThreadCount().
+    int threadCount() const;
+    void setThreadCount(int count);
+    //! Files up to this size are hashed in batches of up to batchSize() bytes.
+    qint64 smallFileSize() const;
+    void setSmallFileSize(qint64 size);
+    qint64 batchSize() const;
+    void setBatchSize(qint64 size);
+    //! Files of at least twice this size are split into ranges of this size, if the algorithm
+    //! is combinable.
+    qint64 rangeSize() const;
+    void setRangeSize(qint64 size);
+
+    //! Hash all files below rootPath, or rootPath itself if it is a file. Symbolic links are
+    //! skipped. Blocks until everything is hashed and reported.
+    Statistics hashTree(const QString &rootPath, const ResultCallback &callback);
+
+private:
+    Q_DISABLE_COPY(TreeHasher)
+
+    struct Run;
+
+    std::unique_ptr<HashAlgorithm> m_algorithm;
+    int m_threadCount = 0;
+    qint64 m_smallFileSize = Q_INT64_C(65536);
+    qint64 m_batchSize = Q_INT64_C(1048576);
+    qint64 m_rangeSize = Q_INT64_C(67108864);
+};
+
+} // namespace hashing
+} // namespace qkeeg
+
+#endif // TREEHASHER_HPP
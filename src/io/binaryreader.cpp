@@ -27,13 +27,13 @@ namespace qkeeg { namespace io {
 
 BinaryReader::BinaryReader(QIODevice &readDevice, const QSysInfo::Endian &byteOrder) :
     m_baseDevice(&readDevice), m_codec(QTextCodec::codecForName(m_defaultEncoding)),
-    m_byteOrder(byteOrder)
+    m_byteOrder(byteOrder), m_status(Ok)
 {
     m_doswap = (QSysInfo::ByteOrder != m_byteOrder) ? true : false;
 }
 
 BinaryReader::BinaryReader(QIODevice &readDevice, QTextCodec *codec, const QSysInfo::Endian &byteOrder) :
-    m_baseDevice(&readDevice), m_codec(codec), m_byteOrder(byteOrder)
+    m_baseDevice(&readDevice), m_codec(codec), m_byteOrder(byteOrder), m_status(Ok)
 {
     m_doswap = (QSysInfo::ByteOrder != m_byteOrder) ? true : false;
     if (m_codec == nullptr)
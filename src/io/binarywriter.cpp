@@ -27,13 +27,13 @@ namespace qkeeg { namespace io {
 
 BinaryWriter::BinaryWriter(QIODevice &writeDevice, const QSysInfo::Endian &byteOrder) :
     m_baseDevice(&writeDevice), m_codec(QTextCodec::codecForName(m_defaultEncoding)),
-    m_byteOrder(byteOrder)
+    m_byteOrder(byteOrder), m_status(Ok)
 {
     m_doswap = (QSysInfo::ByteOrder != m_byteOrder) ? true : false;
 }
 
 BinaryWriter::BinaryWriter(QIODevice &writeDevice, QTextCodec *codec, const QSysInfo::Endian &byteOrder) :
-    m_baseDevice(&writeDevice), m_codec(codec), m_byteOrder(byteOrder)
+    m_baseDevice(&writeDevice), m_codec(codec), m_byteOrder(byteOrder), m_status(Ok)
 {
     m_doswap = (QSysInfo::ByteOrder != m_byteOrder) ? true : false;
     if (m_codec == nullptr) {
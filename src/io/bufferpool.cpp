@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "bufferpool.hpp"
+#include <QString>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+namespace qkeeg { namespace io {
+
+namespace {
+
+qint64 alignUp(qint64 value, qint64 alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+} // anonymous namespace
+
+BufferPool::Buffer::Buffer()
+{
+
+}
+
+BufferPool::Buffer::Buffer(Buffer &&other) Q_DECL_NOEXCEPT :
+    m_pool(other.m_pool), m_data(other.m_data), m_size(other.m_size), m_allocated(other.m_allocated),
+    m_mapped(other.m_mapped), m_hugePages(other.m_hugePages)
+{
+    other.m_pool = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_allocated = 0;
+}
+
+BufferPool::Buffer &BufferPool::Buffer::operator=(Buffer &&other) Q_DECL_NOEXCEPT
+{
+    if (this != &other) {
+        Buffer old(std::move(*this));
+        std::swap(m_pool, other.m_pool);
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_allocated, other.m_allocated);
+        std::swap(m_mapped, other.m_mapped);
+        std::swap(m_hugePages, other.m_hugePages);
+    }
+
+    return *this;
+}
+
+BufferPool::Buffer::~Buffer()
+{
+    if (m_data == nullptr) {
+        return;
+    }
+
+    if (m_pool != nullptr) {
+        m_pool->release(*this);
+    }
+    else {
+        BufferPool::deallocate(*this);
+    }
+}
+
+char *BufferPool::Buffer::data() const
+{
+    return m_data;
+}
+
+qint64 BufferPool::Buffer::size() const
+{
+    return m_size;
+}
+
+bool BufferPool::Buffer::isNull() const
+{
+    return m_data == nullptr;
+}
+
+BufferPool::BufferPool(qint64 bufferSize, int maxCached) :
+    m_bufferSize(alignUp(qMax(bufferSize, Q_INT64_C(1)), Alignment)), m_maxCached(qMax(maxCached, 0))
+{
+
+}
+
+BufferPool::~BufferPool()
+{
+    clear();
+}
+
+qint64 BufferPool::bufferSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bufferSize;
+}
+
+void BufferPool::setBufferSize(qint64 size)
+{
+    if (size <= 0) {
+        throw QString("Invalid buffer size.");
+    }
+
+    std::vector<Buffer> idle;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_bufferSize = alignUp(size, Alignment);
+        idle.swap(m_idle);
+    }
+}
+
+BufferPool::HugePages BufferPool::hugePages() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hugePages;
+}
+
+void BufferPool::setHugePages(HugePages mode)
+{
+    std::vector<Buffer> idle;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_hugePages = mode;
+        idle.swap(m_idle);
+    }
+}
+
+int BufferPool::maxCached() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxCached;
+}
+
+void BufferPool::setMaxCached(int count)
+{
+    std::vector<Buffer> idle;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_maxCached = qMax(count, 0);
+        while (static_cast<int>(m_idle.size()) > m_maxCached) {
+            idle.push_back(std::move(m_idle.back()));
+            m_idle.pop_back();
+        }
+    }
+}
+
+BufferPool::Buffer BufferPool::acquire()
+{
+    return acquire(bufferSize());
+}
+
+BufferPool::Buffer BufferPool::acquire(qint64 size)
+{
+    Buffer buffer;
+    HugePages mode;
+    {
+        QMutexLocker locker(&m_mutex);
+        if ((size == m_bufferSize) && !m_idle.empty()) {
+            buffer = std::move(m_idle.back());
+            m_idle.pop_back();
+        }
+        mode = m_hugePages;
+    }
+
+    if (buffer.isNull() && !allocate(buffer, qMax(size, Q_INT64_C(1)), mode)) {
+        throw QString("Unable to allocate read buffers.");
+    }
+
+    buffer.m_pool = this;
+    return buffer;
+}
+
+void BufferPool::clear()
+{
+    std::vector<Buffer> idle;
+    {
+        QMutexLocker locker(&m_mutex);
+        idle.swap(m_idle);
+    }
+}
+
+void BufferPool::release(Buffer &buffer)
+{
+    buffer.m_pool = nullptr;
+
+    QMutexLocker locker(&m_mutex);
+    const bool keep = (buffer.m_size == m_bufferSize) && (buffer.m_hugePages == m_hugePages) &&
+            (static_cast<int>(m_idle.size()) < m_maxCached);
+    if (keep) {
+        m_idle.push_back(std::move(buffer));
+        return;
+    }
+
+    locker.unlock();
+    deallocate(buffer);
+}
+
+bool BufferPool::allocate(Buffer &buffer, qint64 size, HugePages mode)
+{
+    const qint64 allocated = alignUp(size, Alignment);
+    buffer.m_size = size;
+    buffer.m_hugePages = mode;
+
+#if defined(Q_OS_LINUX) && defined(MAP_HUGETLB)
+    if ((mode == HugePages::Explicit) && (size >= HugePageSize)) {
+        const qint64 mappedSize = alignUp(size, HugePageSize);
+        void *memory = ::mmap(nullptr, static_cast<size_t>(mappedSize), PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            buffer.m_data = static_cast<char*>(memory);
+            buffer.m_allocated = mappedSize;
+            buffer.m_mapped = true;
+            return true;
+        }
+    }
+#endif
+
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+    if ((mode != HugePages::Off) && (size >= HugePageSize)) {
+        // Aligned to the huge page size so khugepaged can back it with whole huge pages.
+        const qint64 alignedSize = alignUp(size, HugePageSize);
+        buffer.m_data = static_cast<char*>(qMallocAligned(static_cast<size_t>(alignedSize), HugePageSize));
+        if (buffer.m_data != nullptr) {
+            ::madvise(buffer.m_data, static_cast<size_t>(alignedSize), MADV_HUGEPAGE);
+            buffer.m_allocated = alignedSize;
+            buffer.m_mapped = false;
+            return true;
+        }
+    }
+#endif
+
+    buffer.m_data = static_cast<char*>(qMallocAligned(static_cast<size_t>(allocated), Alignment));
+    buffer.m_allocated = allocated;
+    buffer.m_mapped = false;
+    return buffer.m_data != nullptr;
+}
+
+void BufferPool::deallocate(Buffer &buffer)
+{
+#ifdef Q_OS_LINUX
+    if (buffer.m_mapped) {
+        ::munmap(buffer.m_data, static_cast<size_t>(buffer.m_allocated));
+    }
+    else
+#endif
+    {
+        qFreeAligned(buffer.m_data);
+    }
+
+    buffer.m_data = nullptr;
+    buffer.m_size = 0;
+    buffer.m_allocated = 0;
+}
+
+} // namespace io
+} // namespace qkeeg
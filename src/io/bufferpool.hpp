@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <QMutex>
+#include <QtGlobal>
+#include <vector>
+
+namespace qkeeg { namespace io {
+
+/// Thread safe pool of page aligned I/O buffers. Buffers of the pool's bufferSize() are kept
+/// when they are handed back, so reading many small files doesn't go through the allocator
+/// each time. The alignment also satisfies O_DIRECT and cache line sized loads.
+class BufferPool
+{
+public:
+    /// Alignment of every buffer.
+    static const qint64 Alignment = 4096;
+
+    /// How buffers are backed. Huge pages are only used on Linux, for buffers of at least
+    /// HugePageSize; Explicit needs pages reserved in vm.nr_hugepages and falls back to
+    /// Transparent when there are none.
+    enum class HugePages { Off, Transparent, Explicit };
+    static const qint64 HugePageSize = Q_INT64_C(2097152);
+
+    /// A buffer on loan from the pool, handed back when it goes out of scope. Move only.
+    class Buffer
+    {
+    public:
+        Buffer();
+        Buffer(Buffer &&other) Q_DECL_NOEXCEPT;
+        Buffer &operator=(Buffer &&other) Q_DECL_NOEXCEPT;
+        ~Buffer();
+
+        char *data() const;
+        qint64 size() const;
+        bool isNull() const;
+
+    private:
+        friend class BufferPool;
+        Q_DISABLE_COPY(Buffer)
+
+        BufferPool *m_pool = nullptr;
+        char *m_data       = nullptr;
+        qint64 m_size      = 0;
+        qint64 m_allocated = 0;
+        bool m_mapped      = false;
+        HugePages m_hugePages = HugePages::Off;
+    };
+
+    /// bufferSize is rounded up to a multiple of Alignment. maxCached bounds how many idle
+    /// buffers are kept.
+    explicit BufferPool(qint64 bufferSize, int maxCached = 16);
+    ~BufferPool();
+
+    qint64 bufferSize() const;
+    /// Takes effect for buffers acquired from now on, idle buffers of the old size are freed.
+    void setBufferSize(qint64 size);
+    HugePages hugePages() const;
+    void setHugePages(HugePages mode);
+    int maxCached() const;
+    void setMaxCached(int count);
+
+    /// Buffer of bufferSize() bytes. Throws a QString if memory can't be allocated.
+    Buffer acquire();
+    /// Buffer of at least size bytes; only buffers of bufferSize() come from and go back to the pool.
+    Buffer acquire(qint64 size);
+    /// Free all idle buffers.
+    void clear();
+
+private:
+    Q_DISABLE_COPY(BufferPool)
+
+    void release(Buffer &buffer);
+    static bool allocate(Buffer &buffer, qint64 size, HugePages mode);
+    static void deallocate(Buffer &buffer);
+
+    mutable QMutex m_mutex;
+    qint64 m_bufferSize;
+    int m_maxCached;
+    HugePages m_hugePages = HugePages::Off;
+    std::vector<Buffer> m_idle;
+};
+
+} // namespace io
+} // namespace qkeeg
+
+#endif // BUFFERPOOL_HPP
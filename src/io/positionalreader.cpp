@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "positionalreader.hpp"
+#include <QFile>
+#include <QFileDevice>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace qkeeg { namespace io {
+
+PositionalReader::PositionalReader(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray nativePath = QFile::encodeName(path);
+    do {
+        m_fd = ::open(nativePath.constData(), O_RDONLY | O_CLOEXEC);
+    } while ((m_fd < 0) && (errno == EINTR));
+
+    struct stat info;
+    if ((m_fd >= 0) && (::fstat(m_fd, &info) == 0) && S_ISREG(info.st_mode)) {
+        m_ownsFd = true;
+        m_size = static_cast<qint64>(info.st_size);
+        return;
+    }
+
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#else
+    m_file.reset(new QFile(path));
+    if (m_file->open(QIODevice::ReadOnly) && !m_file->isSequential()) {
+        m_device = m_file.get();
+        m_size = m_file->size();
+    }
+#endif
+}
+
+PositionalReader::PositionalReader(QIODevice &device)
+{
+    if (!device.isOpen() || !device.isReadable() || device.isSequential()) {
+        return;
+    }
+
+#ifdef Q_OS_UNIX
+    QFileDevice *file = qobject_cast<QFileDevice*>(&device);
+    if ((file != nullptr) && (file->handle() >= 0) && !file->isTextModeEnabled()) {
+        // pread() bypasses QFileDevice's buffer, anything still in the write buffer has to reach the file first.
+        if (file->isWritable()) {
+            file->flush();
+        }
+
+        m_fd = file->handle();
+        m_size = file->size();
+        return;
+    }
+#endif
+
+    m_device = &device;
+    m_size = device.size();
+}
+
+PositionalReader::~PositionalReader()
+{
+#ifdef Q_OS_UNIX
+    if (m_ownsFd) {
+        ::close(m_fd);
+    }
+#endif
+}
+
+bool PositionalReader::isOpen() const
+{
+    return (m_fd >= 0) || (m_device != nullptr);
+}
+
+qint64 PositionalReader::size() const
+{
+    return m_size;
+}
+
+qint64 PositionalReader::read(void *data, qint64 length, qint64 offset)
+{
+    if ((data == nullptr) || (length < 0) || (offset < 0) || !isOpen()) {
+        return -1;
+    }
+
+    char *buffer = static_cast<char*>(data);
+
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0) {
+        qint64 total = 0;
+        while (total < length) {
+            const ssize_t numBytesRead = ::pread(m_fd, buffer + total, static_cast<size_t>(length - total),
+                                                 static_cast<off_t>(offset + total));
+            if (numBytesRead > 0) {
+                total += numBytesRead;
+                continue;
+            }
+            if (numBytesRead == 0) {
+                break;
+            }
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+
+        return total;
+    }
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    return readLocked(buffer, length, offset);
+}
+
+qint64 PositionalReader::nextData(qint64 offset)
+{
+#if defined(Q_OS_UNIX) && defined(SEEK_DATA)
+    return seekExtent(offset, SEEK_DATA, offset);
+#else
+    return offset;
+#endif
+}
+
+qint64 PositionalReader::nextHole(qint64 offset)
+{
+#if defined(Q_OS_UNIX) && defined(SEEK_HOLE)
+    return seekExtent(offset, SEEK_HOLE, m_size);
+#else
+    Q_UNUSED(offset);
+    return m_size;
+#endif
+}
+
+qint64 PositionalReader::seekExtent(qint64 offset, int whence, qint64 fallback)
+{
+    if ((offset < 0) || (offset >= m_size)) {
+        return m_size;
+    }
+
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0) {
+        // lseek() moves the descriptor's position, which a borrowed QFileDevice relies on.
+        QMutexLocker locker(&m_mutex);
+        const off_t position = ::lseek(m_fd, 0, SEEK_CUR);
+        const off_t result = ::lseek(m_fd, static_cast<off_t>(offset), whence);
+        const int error = errno;
+        ::lseek(m_fd, position, SEEK_SET);
+
+        if (result >= 0) {
+            return static_cast<qint64>(result);
+        }
+        // No data past offset, the rest of the file is a hole.
+        if (error == ENXIO) {
+            return m_size;
+        }
+    }
+#else
+    Q_UNUSED(whence);
+#endif
+
+    // Holes aren't supported here.
+    return fallback;
+}
+
+qint64 PositionalReader::readLocked(char *data, qint64 length, qint64 offset)
+{
+    const qint64 position = m_device->pos();
+    if (!m_device->seek(offset)) {
+        return -1;
+    }
+
+    qint64 total = 0;
+    while (total < length) {
+        const qint64 numBytesRead = m_device->read(data + total, length - total);
+        if (numBytesRead < 0) {
+            m_device->seek(position);
+            return -1;
+        }
+        if (numBytesRead == 0) {
+            break;
+        }
+
+        total += numBytesRead;
+    }
+
+    m_device->seek(position);
+    return total;
+}
+
+} // namespace io
+} // namespace qkeeg
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef POSITIONALREADER_HPP
+#define POSITIONALREADER_HPP
+
+#include <QIODevice>
+#include <QMutex>
+#include <QString>
+#include <memory>
+
+class QFile;
+
+namespace qkeeg { namespace io {
+
+/// Reads a file at explicit offsets without touching a shared position, so any number of threads
+/// can read different parts of it at once. Uses pread() where available; other devices are read
+/// with seek() and read() under a lock, and their position is restored afterwards.
+class PositionalReader
+{
+public:
+    /// Open the file at path read only. Check isOpen() afterwards.
+    explicit PositionalReader(const QString &path);
+    /// Read from an open device. The device must outlive the reader.
+    explicit PositionalReader(QIODevice &device);
+    ~PositionalReader();
+
+    /// True if the file could be opened.
+    bool isOpen() const;
+    /// Size of the file in bytes, -1 if unknown.
+    qint64 size() const;
+
+    /// Read up to length bytes starting at offset into data. Returns the number of bytes read,
+    /// which is only less than length at the end of the file, or -1 on error. Thread safe.
+    qint64 read(void *data, qint64 length, qint64 offset);
+
+    /// Start of the first data at or after offset, size() if only a hole follows. Uses
+    /// lseek(SEEK_DATA) where available; elsewhere the whole file is data and offset is returned.
+    qint64 nextData(qint64 offset);
+    /// Start of the first hole at or after offset, the end of the file counts as one.
+    qint64 nextHole(qint64 offset);
+
+private:
+    Q_DISABLE_COPY(PositionalReader)
+
+    qint64 readLocked(char *data, qint64 length, qint64 offset);
+    qint64 seekExtent(qint64 offset, int whence, qint64 fallback);
+
+    int m_fd = -1;
+    bool m_ownsFd = false;
+    qint64 m_size = -1;
+
+    std::unique_ptr<QFile> m_file;
+    QIODevice *m_device = nullptr;
+    QMutex m_mutex;
+};
+
+} // namespace io
+} // namespace qkeeg
+
+#endif // POSITIONALREADER_HPP
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "readaheadreader.hpp"
+#include <QThread>
+
+namespace qkeeg { namespace io {
+
+ReadAheadReader::ReadAheadReader(QIODevice &device, qint64 bytesToRead, BufferPool &pool, int bufferCount) :
+    m_device(device), m_bytesToRead(bytesToRead)
+{
+    bufferCount = qMax(bufferCount, 2);
+    m_buffers.reserve(static_cast<std::size_t>(bufferCount));
+    for (int i = 0; i < bufferCount; ++i) {
+        m_buffers.push_back(pool.acquire());
+        m_lengths.append(0);
+    }
+
+    m_blockSize = m_buffers.front().size();
+    m_bufferCount = bufferCount;
+
+    m_thread = QThread::create([this]() { readLoop(); });
+    m_thread->start();
+}
+
+ReadAheadReader::~ReadAheadReader()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_notFull.wakeAll();
+    }
+
+    m_thread->wait();
+    delete m_thread;
+}
+
+const char *ReadAheadReader::next(qint64 &length)
+{
+    QMutexLocker locker(&m_mutex);
+    while ((m_filled == 0) && !m_finished) {
+        m_notEmpty.wait(&m_mutex);
+    }
+
+    if (m_filled == 0) {
+        length = 0;
+        return nullptr;
+    }
+
+    length = m_lengths.at(m_readIndex);
+    return m_buffers[static_cast<std::size_t>(m_readIndex)].data();
+}
+
+void ReadAheadReader::release()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_filled == 0) {
+        return;
+    }
+
+    m_readIndex = (m_readIndex + 1) % m_bufferCount;
+    --m_filled;
+    m_notFull.wakeOne();
+}
+
+bool ReadAheadReader::hasError() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_error;
+}
+
+void ReadAheadReader::readLoop()
+{
+    qint64 remaining = m_bytesToRead;
+    while (remaining > 0) {
+        int slot;
+        {
+            QMutexLocker locker(&m_mutex);
+            while ((m_filled == m_bufferCount) && !m_stop) {
+                m_notFull.wait(&m_mutex);
+            }
+            if (m_stop) {
+                break;
+            }
+
+            slot = m_writeIndex;
+        }
+
+        // The slot is not visible to the consumer until m_filled is raised, so read unlocked.
+        const qint64 numBytesRead = m_device.read(m_buffers[static_cast<std::size_t>(slot)].data(), qMin(remaining, m_blockSize));
+
+        QMutexLocker locker(&m_mutex);
+        if (numBytesRead <= 0) {
+            m_error = true;
+            break;
+        }
+
+        m_lengths[slot] = numBytesRead;
+        m_writeIndex = (m_writeIndex + 1) % m_bufferCount;
+        ++m_filled;
+        m_notEmpty.wakeOne();
+        remaining -= numBytesRead;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_finished = true;
+    m_notEmpty.wakeAll();
+}
+
+} // namespace io
+} // namespace qkeeg
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 Larry Lopez
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef READAHEADREADER_HPP
+#define READAHEADREADER_HPP
+
+#include "bufferpool.hpp"
+#include <QIODevice>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <vector>
+
+class QThread;
+
+namespace qkeeg { namespace io {
+
+/// Reads a device on a background thread into a ring of aligned buffers, so the consumer can
+/// process one block while the next ones are read. The ring is bounded: the reader waits when
+/// every buffer is full. The device must not be touched by anyone else while this reads it.
+class ReadAheadReader
+{
+public:
+    /// Read bytesToRead bytes from the current position of device, into bufferCount buffers
+    /// taken from pool; each block is up to pool.bufferSize() bytes.
+    ReadAheadReader(QIODevice &device, qint64 bytesToRead, BufferPool &pool, int bufferCount = 4);
+    /// Stops the reader thread and waits for it.
+    ~ReadAheadReader();
+
+    /// Wait for the next block. Returns nullptr when everything was read or on a read error.
+    /// The block stays valid until release() is called.
+    const char *next(qint64 &length);
+    /// Hand the block from next() back to the reader.
+    void release();
+
+    /// True if the device returned an error or ended early.
+    bool hasError() const;
+
+private:
+    Q_DISABLE_COPY(ReadAheadReader)
+
+    void readLoop();
+
+    QIODevice &m_device;
+    qint64 m_bytesToRead;
+    qint64 m_blockSize;
+    std::vector<BufferPool::Buffer> m_buffers;
+    int m_bufferCount;
+    QVector<qint64> m_lengths;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    int m_readIndex  = 0;
+    int m_writeIndex = 0;
+    int m_filled     = 0;
+    bool m_finished  = false;
+    bool m_error     = false;
+    bool m_stop      = false;
+
+    QThread *m_thread = nullptr;
+};
+
+} // namespace io
+} // namespace qkeeg
+
+#endif // READAHEADREADER_HPP